@@ -6,6 +6,9 @@ using namespace emscripten;
 
 EMSCRIPTEN_BINDINGS(module)
 {
+    // set_progress_callback and cancel are not bound yet. The page runs the simulation on its only thread, so a
+    // callback could not update the page and a cancel button could not be pressed before the call returns. They
+    // need the simulation to run in a web worker first.
     class_<Sim_interface>("Sim_interface")
         .constructor<>()
         .function("simulate", &Sim_interface::simulate)
@@ -0,0 +1,399 @@
+// Micro and macro benchmarks of the simulator, built as wow_bench when Google Benchmark is installed.
+//
+// Results are written as JSON unless another --benchmark_format is given, e.g.
+//     wow_bench --benchmark_out=bench.json
+// Simulation benchmarks report fights_per_second, which can be compared between releases.
+
+#include "Armory.hpp"
+#include "Combat_simulator.hpp"
+#include "Helper_functions.hpp"
+#include "Item_optimizer.hpp"
+#include "sim_interface.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+struct Gear_set
+{
+    const char* name;
+    std::vector<std::string> armor;
+    std::vector<std::string> weapons;
+};
+
+// Reference gear sets. The armor is listed in the socket order of character_setup.
+const std::vector<Gear_set>& reference_gear_sets()
+{
+    static const std::vector<Gear_set> gear_sets = {
+        {"bwl",
+         {"lionheart_helm", "onyxia_tooth_pendant", "drake_talon_pauldrons", "cape_of_the_black_baron",
+          "savage_gladiator_chain", "wristguards_of_stability", "flameguard_gauntlets", "onslaught_girdle",
+          "cloudkeeper_legplates", "chromatic_boots", "might_of_cenarius", "master_dragonslayers_ring",
+          "badge_of_the_swarmguard", "diamond_flask", "blastershot"},
+         {"thunderfury_blessed_blade", "dal_rends_tribal_guardian"}},
+        {"aq40",
+         {"conquerors_crown", "barbed_choker", "conquerors_spaulders", "cloak_of_the_shrouded_mists",
+          "conquerors_breastplate", "hive_defiler_wristguards", "gauntlets_of_annihilation", "onslaught_girdle",
+          "conquerors_legguards", "chromatic_boots", "quick_strike_ring", "circle_of_applied_force",
+          "jom_gabbar", "badge_of_the_swarmguard", "larvae_of_the_great_worm"},
+         {"thunderfury_blessed_blade", "brutality_blade"}},
+    };
+    return gear_sets;
+}
+
+const std::vector<std::string> reference_buffs = {
+    "rallying_cry",     "dire_maul",      "songflower",        "warchiefs_blessing", "spirit_of_zandalar",
+    "sayges_fortune",   "windfury_totem", "blessing_of_kings", "mighty_rage_potion"};
+
+const std::vector<std::string> reference_enchants = {"e+8 strength", "s+30 attack power", "mcrusader", "ocrusader"};
+
+const std::vector<std::string> reference_options = {
+    "faerie_fire",    "recklessness",   "enable_blood_fury", "curse_of_recklessness", "death_wish",
+    "use_bloodthirst", "use_whirlwind", "use_heroic_strike", "use_hamstring",         "use_overpower",
+    "deep_wounds"};
+
+Sim_input reference_input(const Gear_set& gear_set, int n_simulations)
+{
+    return {{"orc"},
+            gear_set.armor,
+            gear_set.weapons,
+            reference_buffs,
+            reference_enchants,
+            {},
+            reference_options,
+            {},
+            {},
+            60,
+            63,
+            static_cast<double>(n_simulations),
+            0,
+            5,
+            60,
+            60,
+            25,
+            1,
+            2.0,
+            80,
+            50,
+            2,
+            1.5,
+            45};
+}
+
+Character reference_character(const Armory& armory, const Gear_set& gear_set)
+{
+    const std::vector<Socket> sockets = {Socket::head,   Socket::neck,  Socket::shoulder, Socket::back,
+                                         Socket::chest,  Socket::wrist, Socket::hands,    Socket::belt,
+                                         Socket::legs,   Socket::boots, Socket::ring,     Socket::ring,
+                                         Socket::trinket, Socket::trinket, Socket::ranged};
+    auto character = get_character_of_race("orc");
+    for (size_t i = 0; i < sockets.size(); i++)
+    {
+        character.equip_armor(armory.find_armor(sockets[i], gear_set.armor[i]));
+    }
+    character.equip_weapon(armory.find_weapon(gear_set.weapons[0]), armory.find_weapon(gear_set.weapons[1]));
+    armory.add_enchants_to_character(character, reference_enchants);
+    armory.add_buffs_to_character(character, reference_buffs);
+    armory.compute_total_stats(character);
+    return character;
+}
+
+// Combat_simulator with the hit tables of the reference character set up, as they are at the start of a fight
+struct Simulator_fixture
+{
+    explicit Simulator_fixture(const Gear_set& gear_set)
+        : character{reference_character(armory, gear_set)}, config{reference_input(gear_set, 1000)}
+    {
+        simulator.set_config(config);
+        for (const auto& wep : character.weapons)
+        {
+            weapons.emplace_back(wep.swing_speed, wep.min_damage, wep.max_damage, wep.socket, wep.type,
+                                 wep.weapon_socket, wep.hit_effects);
+            weapons.back().compute_weapon_damage(wep.buff.bonus_damage + character.total_special_stats.bonus_damage);
+            simulator.compute_hit_table(config.opponent_level - character.level,
+                                        get_weapon_skill(character.total_special_stats, wep.type),
+                                        character.total_special_stats, wep.socket);
+        }
+    }
+
+    Armory armory;
+    Character character;
+    Combat_simulator_config config;
+    Combat_simulator simulator;
+    std::vector<Weapon_sim> weapons;
+};
+
+// Silences the progress messages that the optimizer prints, so they do not end up in the JSON on stdout
+class Silence_cout
+{
+public:
+    Silence_cout() : buffer_{std::cout.rdbuf(nullptr)} {}
+
+    ~Silence_cout()
+    {
+        std::cout.rdbuf(buffer_);
+        std::cout.clear();
+    }
+
+private:
+    std::streambuf* buffer_;
+};
+
+void set_gear_set_label(benchmark::State& state)
+{
+    state.SetLabel(reference_gear_sets()[state.range(0)].name);
+}
+
+void add_gear_set_args(benchmark::internal::Benchmark* benchmark)
+{
+    for (size_t i = 0; i < reference_gear_sets().size(); i++)
+    {
+        benchmark->Arg(static_cast<int64_t>(i));
+    }
+}
+} // namespace
+
+// Micro benchmarks
+
+// Draws from the white and yellow hit tables. The procs that generate_hit triggers on top of this need the buffs of
+// a running fight, so they are covered by the macro benchmarks.
+void BM_generate_hit(benchmark::State& state)
+{
+    Simulator_fixture fixture{reference_gear_sets()[state.range(0)]};
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(fixture.simulator.generate_hit_mh<false>(1000.0, Combat_simulator::Hit_type::white));
+        benchmark::DoNotOptimize(fixture.simulator.generate_hit_mh<false>(1000.0, Combat_simulator::Hit_type::yellow));
+        benchmark::DoNotOptimize(fixture.simulator.generate_hit_oh<false>(1000.0));
+    }
+    state.SetItemsProcessed(state.iterations() * 3);
+    set_gear_set_label(state);
+}
+BENCHMARK(BM_generate_hit)->Apply(add_gear_set_args);
+
+void BM_compute_hit_table(benchmark::State& state)
+{
+    Simulator_fixture fixture{reference_gear_sets()[state.range(0)]};
+    const auto& character = fixture.character;
+    for (auto _ : state)
+    {
+        for (const auto& wep : character.weapons)
+        {
+            fixture.simulator.compute_hit_table(fixture.config.opponent_level - character.level,
+                                                get_weapon_skill(character.total_special_stats, wep.type),
+                                                character.total_special_stats, wep.socket);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(character.weapons.size()));
+    set_gear_set_label(state);
+}
+BENCHMARK(BM_compute_hit_table)->Apply(add_gear_set_args);
+
+// Runs the buff bookkeeping of one fight: the character's use effects plus a stream of short procs
+void BM_buff_manager_increment(benchmark::State& state)
+{
+    Simulator_fixture fixture{reference_gear_sets()[state.range(0)]};
+    Buff_manager buff_manager;
+    const int proc_id = buff_manager.get_id("benchmark_proc");
+    const Special_stats proc_stats{0, 0, 100};
+    Over_time_effect over_time_effect{"benchmark_over_time", {}, 1, 0, 3, 12};
+    over_time_effect.id = buff_manager.get_id(over_time_effect.name);
+    std::vector<Use_effect> use_effects = fixture.character.use_effects;
+    for (auto& use_effect : use_effects)
+    {
+        use_effect.id = buff_manager.get_id(use_effect.name);
+        for (auto& hit_effect : use_effect.hit_effects)
+        {
+            hit_effect.id = buff_manager.get_id(hit_effect.name);
+        }
+        for (auto& effect : use_effect.over_time_effects)
+        {
+            effect.id = buff_manager.get_id(effect.name);
+        }
+    }
+    const double sim_time = fixture.config.sim_time;
+    std::vector<std::string> status;
+    int64_t n_increments = 0;
+    for (auto _ : state)
+    {
+        Special_stats special_stats = fixture.character.total_special_stats;
+        buff_manager.initialize(special_stats, use_effects, true);
+        double rage = 0;
+        double rage_lost_stance = 0;
+        double rage_lost_exec = 0;
+        double global_cooldown_ready = 0;
+        for (double time = 0.0; time < sim_time; time += 0.5)
+        {
+            buff_manager.increment<false>(time, sim_time - time, rage, rage_lost_stance, rage_lost_exec,
+                                          global_cooldown_ready, status);
+            buff_manager.add(proc_id, proc_stats, 10.0);
+            if (static_cast<int>(time) % 6 == 0)
+            {
+                buff_manager.add_over_time_effect(over_time_effect, static_cast<int>(time));
+            }
+            n_increments++;
+        }
+        benchmark::DoNotOptimize(special_stats);
+    }
+    state.SetItemsProcessed(n_increments);
+    set_gear_set_label(state);
+}
+BENCHMARK(BM_buff_manager_increment)->Apply(add_gear_set_args);
+
+void BM_compute_total_stats(benchmark::State& state)
+{
+    Armory armory;
+    Character character = reference_character(armory, reference_gear_sets()[state.range(0)]);
+    for (auto _ : state)
+    {
+        armory.compute_total_stats(character);
+        benchmark::DoNotOptimize(character.total_special_stats);
+    }
+    set_gear_set_label(state);
+}
+BENCHMARK(BM_compute_total_stats)->Apply(add_gear_set_args);
+
+// Candidates from the union of the reference gear sets
+void setup_reference_optimizer(Item_optimizer& item_optimizer)
+{
+    std::vector<std::string> armor;
+    std::vector<std::string> weapons;
+    for (const auto& gear_set : reference_gear_sets())
+    {
+        armor.insert(armor.end(), gear_set.armor.begin(), gear_set.armor.end());
+        weapons.insert(weapons.end(), gear_set.weapons.begin(), gear_set.weapons.end());
+    }
+    item_optimizer.race = get_race("orc");
+    item_optimizer.buffs_vec = reference_buffs;
+    item_optimizer.ench_vec = reference_enchants;
+    item_optimizer.item_setup(armor, weapons);
+    item_optimizer.compute_combinations();
+    item_optimizer.sim_time = 60;
+}
+
+void BM_item_optimizer_construct(benchmark::State& state)
+{
+    Item_optimizer item_optimizer;
+    setup_reference_optimizer(item_optimizer);
+    size_t index = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(item_optimizer.construct(index));
+        index = (index + 1) % item_optimizer.total_combinations;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["combinations"] = static_cast<double>(item_optimizer.total_combinations);
+}
+BENCHMARK(BM_item_optimizer_construct);
+
+// The heuristic prefilter of simulate_mult, items_per_second counts gear sets
+void BM_item_optimizer_ap_equivalents(benchmark::State& state)
+{
+    Item_optimizer item_optimizer;
+    setup_reference_optimizer(item_optimizer);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(item_optimizer.compute_ap_equivalents());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * item_optimizer.total_combinations));
+    state.counters["combinations"] = static_cast<double>(item_optimizer.total_combinations);
+}
+BENCHMARK(BM_item_optimizer_ap_equivalents);
+
+// The branch and bound search that replaces the full prefilter pass, keeping the best 1000 sets
+void BM_item_optimizer_best_ap_equivalents(benchmark::State& state)
+{
+    Item_optimizer item_optimizer;
+    setup_reference_optimizer(item_optimizer);
+    std::string debug_message;
+    Silence_cout silence_cout;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(item_optimizer.find_best_ap_equivalents(1000, debug_message));
+        debug_message.clear();
+    }
+    state.counters["combinations"] = static_cast<double>(item_optimizer.total_combinations);
+}
+BENCHMARK(BM_item_optimizer_best_ap_equivalents);
+
+// Macro benchmarks
+
+void BM_simulate(benchmark::State& state)
+{
+    const int n_simulations = static_cast<int>(state.range(1));
+    Sim_input input = reference_input(reference_gear_sets()[state.range(0)], n_simulations);
+    Sim_interface sim_interface;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(sim_interface.simulate(input));
+    }
+    state.counters["fights_per_second"] =
+        benchmark::Counter(static_cast<double>(state.iterations() * n_simulations), benchmark::Counter::kIsRate);
+    set_gear_set_label(state);
+}
+BENCHMARK(BM_simulate)->ArgsProduct({{0, 1}, {5000}})->Unit(benchmark::kMillisecond);
+
+// Optimizes over the union of the reference gear sets, i.e., two candidates for almost every socket
+void BM_simulate_mult(benchmark::State& state)
+{
+    Sim_input_mult input;
+    input.race = {"orc"};
+    for (const auto& gear_set : reference_gear_sets())
+    {
+        input.armor.insert(input.armor.end(), gear_set.armor.begin(), gear_set.armor.end());
+        input.weapons.insert(input.weapons.end(), gear_set.weapons.begin(), gear_set.weapons.end());
+    }
+    input.buffs = reference_buffs;
+    input.enchants = reference_enchants;
+    input.options = reference_options;
+    input.fight_time = 60;
+    input.target_level = 63;
+    input.sunder_armor = 5;
+    input.heroic_strike_rage_thresh = 60;
+    input.cleave_rage_thresh = 60;
+    input.whirlwind_rage_thresh = 25;
+    input.whirlwind_bt_cooldown_thresh = 1;
+    input.hamstring_cd_thresh = 2.0;
+    input.hamstring_thresh_dd = 80;
+    input.overpower_rage_thresh = 50;
+    input.overpower_bt_cooldown_thresh = 2;
+    input.overpower_ww_cooldown_thresh = 1.5;
+    input.initial_rage = 45;
+    input.max_optimize_time = static_cast<double>(state.range(0));
+    Sim_interface sim_interface;
+    for (auto _ : state)
+    {
+        Silence_cout silence_cout;
+        benchmark::DoNotOptimize(sim_interface.simulate_mult(input));
+    }
+}
+BENCHMARK(BM_simulate_mult)->Arg(10)->Unit(benchmark::kMillisecond)->Iterations(1);
+
+int main(int argc, char** argv)
+{
+    // JSON by default, so the results can be stored and compared between releases
+    std::vector<char*> args(argv, argv + argc);
+    bool has_format = false;
+    for (int i = 1; i < argc; i++)
+    {
+        has_format |= std::strncmp(argv[i], "--benchmark_format", std::strlen("--benchmark_format")) == 0;
+    }
+    char json_format[] = "--benchmark_format=json";
+    if (!has_format)
+    {
+        args.push_back(json_format);
+    }
+    int n_args = static_cast<int>(args.size());
+    benchmark::Initialize(&n_args, args.data());
+    if (benchmark::ReportUnrecognizedArguments(n_args, args.data()))
+    {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
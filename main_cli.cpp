@@ -0,0 +1,888 @@
+// Native batch runner, built as wow_cli. Reads one simulation job per line (JSON lines) from a file or stdin, runs
+// the jobs on a pool of worker threads and writes one JSON line per finished job to stdout:
+//     wow_cli [--jobs N] [--progress] [jobs.jsonl]
+//
+// A job names the interface call and its input, with the member names of Sim_input or Sim_input_mult:
+//     {"id": "bwl", "type": "simulate", "input": {"race": ["orc"], "armor": [...], "fight_time": 60, ...}}
+//     {"id": 7, "type": "simulate_mult", "input": {"race": ["orc"], "armor": [...], "max_optimize_time": 600, ...}}
+// Missing input members keep their default, and a job whose input can not be simulated, e.g. without a race or
+// with fewer than 15 armor items, gets an error instead of a result. The result echoes the id and the line number of
+// the job, followed by the members of Sim_output or Sim_output_mult, or by an error message:
+//     {"line": 1, "id": "bwl", "type": "simulate", "output": {"hist_x": [...], ...}}
+//     {"line": 2, "id": 7, "error": "unknown input member 'armour'"}
+// Results are written in the order the jobs finish. The log of the simulator goes to stderr.
+//
+// A job may stop early once the DPS error margin, of the leading set for simulate_mult, is small enough:
+//     {"id": "bwl", "type": "simulate", "max_error_margin": 1.5, "input": {...}}
+// With --progress the progress of the running jobs is written to stderr as JSON lines as well:
+//     {"line": 1, "id": "bwl", "progress": {"n_simulations": 1000, "dps_mean": 1274.5, ...}}
+//
+// Each job runs on the thread of its worker, so --jobs is the number of cores used. The "multi_threaded" option of a
+// job is only followed with --jobs 1, where the job gets all cores. With more workers it is ignored, since every
+// multi-threaded job would start as many simulator threads as there are cores.
+
+#include "Armory.hpp"
+#include "sim_interface.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+struct Json_value
+{
+    enum class Type
+    {
+        null,
+        boolean,
+        number,
+        string,
+        array,
+        object
+    };
+
+    const Json_value* find(const std::string& key) const
+    {
+        auto it = object.find(key);
+        return (it != object.end()) ? &it->second : nullptr;
+    }
+
+    Type type{Type::null};
+    bool boolean{};
+    double number{};
+    std::string string;
+    std::vector<Json_value> array;
+    std::map<std::string, Json_value> object;
+};
+
+// Recursive descent parser for one line of JSON. Parse errors are reported through error, like the rest of the
+// simulator the runner does not use exceptions.
+class Json_parser
+{
+public:
+    explicit Json_parser(const std::string& text) : text_(text) {}
+
+    bool parse(Json_value& value, std::string& error)
+    {
+        if (!parse_value(value, 0))
+        {
+            error = error_ + " at column " + std::to_string(position_ + 1);
+            return false;
+        }
+        skip_whitespace();
+        if (position_ != text_.size())
+        {
+            error = "unexpected text after the job at column " + std::to_string(position_ + 1);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static constexpr int max_depth = 64;
+
+    bool fail(const char* message)
+    {
+        error_ = message;
+        return false;
+    }
+
+    void skip_whitespace()
+    {
+        while (position_ < text_.size() && std::strchr(" \t\r\n", text_[position_]) != nullptr)
+        {
+            position_++;
+        }
+    }
+
+    bool consume(const char* literal)
+    {
+        size_t length = std::strlen(literal);
+        if (text_.compare(position_, length, literal) != 0)
+        {
+            return false;
+        }
+        position_ += length;
+        return true;
+    }
+
+    bool parse_value(Json_value& value, int depth)
+    {
+        if (depth > max_depth)
+        {
+            return fail("too deeply nested");
+        }
+        skip_whitespace();
+        if (position_ == text_.size())
+        {
+            return fail("unexpected end of line");
+        }
+        char c = text_[position_];
+        if (c == '{')
+        {
+            return parse_object(value, depth);
+        }
+        if (c == '[')
+        {
+            return parse_array(value, depth);
+        }
+        if (c == '"')
+        {
+            value.type = Json_value::Type::string;
+            return parse_string(value.string);
+        }
+        if (consume("true") || consume("false"))
+        {
+            value.type = Json_value::Type::boolean;
+            value.boolean = (c == 't');
+            return true;
+        }
+        if (consume("null"))
+        {
+            value.type = Json_value::Type::null;
+            return true;
+        }
+        return parse_number(value);
+    }
+
+    bool parse_object(Json_value& value, int depth)
+    {
+        value.type = Json_value::Type::object;
+        position_++;
+        skip_whitespace();
+        if (consume("}"))
+        {
+            return true;
+        }
+        while (true)
+        {
+            skip_whitespace();
+            if (position_ == text_.size() || text_[position_] != '"')
+            {
+                return fail("expected an object key");
+            }
+            std::string key;
+            if (!parse_string(key))
+            {
+                return false;
+            }
+            skip_whitespace();
+            if (!consume(":"))
+            {
+                return fail("expected ':'");
+            }
+            if (!parse_value(value.object[key], depth + 1))
+            {
+                return false;
+            }
+            skip_whitespace();
+            if (consume("}"))
+            {
+                return true;
+            }
+            if (!consume(","))
+            {
+                return fail("expected ',' or '}'");
+            }
+        }
+    }
+
+    bool parse_array(Json_value& value, int depth)
+    {
+        value.type = Json_value::Type::array;
+        position_++;
+        skip_whitespace();
+        if (consume("]"))
+        {
+            return true;
+        }
+        while (true)
+        {
+            value.array.emplace_back();
+            if (!parse_value(value.array.back(), depth + 1))
+            {
+                return false;
+            }
+            skip_whitespace();
+            if (consume("]"))
+            {
+                return true;
+            }
+            if (!consume(","))
+            {
+                return fail("expected ',' or ']'");
+            }
+        }
+    }
+
+    bool parse_string(std::string& result)
+    {
+        position_++;
+        while (position_ < text_.size())
+        {
+            char c = text_[position_++];
+            if (c == '"')
+            {
+                return true;
+            }
+            if (c != '\\')
+            {
+                result += c;
+                continue;
+            }
+            if (position_ == text_.size())
+            {
+                break;
+            }
+            char escape = text_[position_++];
+            switch (escape)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                result += escape;
+                break;
+            case 'b':
+                result += '\b';
+                break;
+            case 'f':
+                result += '\f';
+                break;
+            case 'n':
+                result += '\n';
+                break;
+            case 'r':
+                result += '\r';
+                break;
+            case 't':
+                result += '\t';
+                break;
+            case 'u':
+            {
+                if (position_ + 4 > text_.size())
+                {
+                    return fail("incomplete \\u escape");
+                }
+                char* end = nullptr;
+                std::string hex = text_.substr(position_, 4);
+                unsigned long code_point = std::strtoul(hex.c_str(), &end, 16);
+                if (end != hex.c_str() + 4)
+                {
+                    return fail("invalid \\u escape");
+                }
+                position_ += 4;
+                // Item and buff names are ASCII, so surrogate pairs are not combined
+                if (code_point < 0x80)
+                {
+                    result += static_cast<char>(code_point);
+                }
+                else if (code_point < 0x800)
+                {
+                    result += static_cast<char>(0xc0 | (code_point >> 6));
+                    result += static_cast<char>(0x80 | (code_point & 0x3f));
+                }
+                else
+                {
+                    result += static_cast<char>(0xe0 | (code_point >> 12));
+                    result += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+                    result += static_cast<char>(0x80 | (code_point & 0x3f));
+                }
+                break;
+            }
+            default:
+                return fail("invalid escape in string");
+            }
+        }
+        return fail("unterminated string");
+    }
+
+    bool parse_number(Json_value& value)
+    {
+        const char* begin = text_.c_str() + position_;
+        char* end = nullptr;
+        value.number = std::strtod(begin, &end);
+        if (end == begin)
+        {
+            return fail("unexpected character");
+        }
+        value.type = Json_value::Type::number;
+        position_ += end - begin;
+        return true;
+    }
+
+    const std::string& text_;
+    size_t position_{};
+    std::string error_;
+};
+
+void write_json(std::ostream& stream, const std::string& string)
+{
+    stream << '"';
+    for (char c : string)
+    {
+        switch (c)
+        {
+        case '"':
+            stream << "\\\"";
+            break;
+        case '\\':
+            stream << "\\\\";
+            break;
+        case '\n':
+            stream << "\\n";
+            break;
+        case '\r':
+            stream << "\\r";
+            break;
+        case '\t':
+            stream << "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                stream << escaped;
+            }
+            else
+            {
+                stream << c;
+            }
+        }
+    }
+    stream << '"';
+}
+
+// Shortest text that reads back to the same double, JSON has no NaN or infinity so they are written as null
+void write_json(std::ostream& stream, double number)
+{
+    if (!std::isfinite(number))
+    {
+        stream << "null";
+        return;
+    }
+    char text[32];
+    for (int precision = 15; precision <= 17; precision++)
+    {
+        std::snprintf(text, sizeof(text), "%.*g", precision, number);
+        if (std::strtod(text, nullptr) == number)
+        {
+            break;
+        }
+    }
+    stream << text;
+}
+
+void write_json(std::ostream& stream, int number)
+{
+    stream << number;
+}
+
+template <typename T>
+void write_json(std::ostream& stream, const std::vector<T>& values)
+{
+    stream << '[';
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        if (i > 0)
+        {
+            stream << ',';
+        }
+        write_json(stream, values[i]);
+    }
+    stream << ']';
+}
+
+void write_json(std::ostream& stream, const Json_value& value)
+{
+    switch (value.type)
+    {
+    case Json_value::Type::null:
+        stream << "null";
+        break;
+    case Json_value::Type::boolean:
+        stream << (value.boolean ? "true" : "false");
+        break;
+    case Json_value::Type::number:
+        write_json(stream, value.number);
+        break;
+    case Json_value::Type::string:
+        write_json(stream, value.string);
+        break;
+    case Json_value::Type::array:
+        write_json(stream, value.array);
+        break;
+    case Json_value::Type::object:
+    {
+        stream << '{';
+        bool first = true;
+        for (const auto& member : value.object)
+        {
+            stream << (first ? "" : ",");
+            write_json(stream, member.first);
+            stream << ':';
+            write_json(stream, member.second);
+            first = false;
+        }
+        stream << '}';
+        break;
+    }
+    }
+}
+
+template <typename T>
+void write_member(std::ostream& stream, const char* name, const T& value, bool first = false)
+{
+    stream << (first ? "" : ",") << '"' << name << "\":";
+    write_json(stream, value);
+}
+
+// Members of the input structs that a job can set, by their JSON names
+template <typename Input>
+struct Input_members
+{
+    std::vector<std::pair<const char*, std::vector<std::string> Input::*>> lists;
+    std::vector<std::pair<const char*, double Input::*>> numbers;
+};
+
+const Input_members<Sim_input>& sim_input_members()
+{
+    static const Input_members<Sim_input> members{
+        {{"race", &Sim_input::race},
+         {"armor", &Sim_input::armor},
+         {"weapons", &Sim_input::weapons},
+         {"buffs", &Sim_input::buffs},
+         {"enchants", &Sim_input::enchants},
+         {"stat_weights", &Sim_input::stat_weights},
+         {"options", &Sim_input::options},
+         {"compare_armor", &Sim_input::compare_armor},
+         {"compare_weapons", &Sim_input::compare_weapons}},
+        {{"fight_time", &Sim_input::fight_time},
+         {"target_level", &Sim_input::target_level},
+         {"n_simulations", &Sim_input::n_simulations},
+         {"n_simulations_stat_weights", &Sim_input::n_simulations_stat_weights},
+         {"sunder_armor", &Sim_input::sunder_armor},
+         {"heroic_strike_rage_thresh", &Sim_input::heroic_strike_rage_thresh},
+         {"cleave_rage_thresh", &Sim_input::cleave_rage_thresh},
+         {"whirlwind_rage_thresh", &Sim_input::whirlwind_rage_thresh},
+         {"whirlwind_bt_cooldown_thresh", &Sim_input::whirlwind_bt_cooldown_thresh},
+         {"hamstring_cd_thresh", &Sim_input::hamstring_cd_thresh},
+         {"hamstring_thresh_dd", &Sim_input::hamstring_thresh_dd},
+         {"overpower_rage_thresh", &Sim_input::overpower_rage_thresh},
+         {"overpower_bt_cooldown_thresh", &Sim_input::overpower_bt_cooldown_thresh},
+         {"overpower_ww_cooldown_thresh", &Sim_input::overpower_ww_cooldown_thresh},
+         {"initial_rage", &Sim_input::initial_rage}}};
+    return members;
+}
+
+const Input_members<Sim_input_mult>& sim_input_mult_members()
+{
+    static const Input_members<Sim_input_mult> members{
+        {{"race", &Sim_input_mult::race},
+         {"armor", &Sim_input_mult::armor},
+         {"weapons", &Sim_input_mult::weapons},
+         {"buffs", &Sim_input_mult::buffs},
+         {"enchants", &Sim_input_mult::enchants},
+         {"options", &Sim_input_mult::options}},
+        {{"fight_time", &Sim_input_mult::fight_time},
+         {"target_level", &Sim_input_mult::target_level},
+         {"sunder_armor", &Sim_input_mult::sunder_armor},
+         {"heroic_strike_rage_thresh", &Sim_input_mult::heroic_strike_rage_thresh},
+         {"cleave_rage_thresh", &Sim_input_mult::cleave_rage_thresh},
+         {"whirlwind_rage_thresh", &Sim_input_mult::whirlwind_rage_thresh},
+         {"whirlwind_bt_cooldown_thresh", &Sim_input_mult::whirlwind_bt_cooldown_thresh},
+         {"hamstring_cd_thresh", &Sim_input_mult::hamstring_cd_thresh},
+         {"hamstring_thresh_dd", &Sim_input_mult::hamstring_thresh_dd},
+         {"overpower_rage_thresh", &Sim_input_mult::overpower_rage_thresh},
+         {"overpower_bt_cooldown_thresh", &Sim_input_mult::overpower_bt_cooldown_thresh},
+         {"overpower_ww_cooldown_thresh", &Sim_input_mult::overpower_ww_cooldown_thresh},
+         {"initial_rage", &Sim_input_mult::initial_rage},
+         {"max_optimize_time", &Sim_input_mult::max_optimize_time}}};
+    return members;
+}
+
+// Fills input from the members of the JSON object. Returns false on unknown members or members of the wrong type.
+template <typename Input>
+bool read_input(const Json_value& json, const Input_members<Input>& members, Input& input, std::string& error)
+{
+    if (json.type != Json_value::Type::object)
+    {
+        error = "'input' must be an object";
+        return false;
+    }
+    for (const auto& member : json.object)
+    {
+        bool known = false;
+        for (const auto& list : members.lists)
+        {
+            if (member.first != list.first)
+            {
+                continue;
+            }
+            known = true;
+            if (member.second.type != Json_value::Type::array)
+            {
+                error = "input member '" + member.first + "' must be an array of strings";
+                return false;
+            }
+            std::vector<std::string>& strings = input.*list.second;
+            strings.clear();
+            for (const auto& element : member.second.array)
+            {
+                if (element.type != Json_value::Type::string)
+                {
+                    error = "input member '" + member.first + "' must be an array of strings";
+                    return false;
+                }
+                strings.push_back(element.string);
+            }
+        }
+        for (const auto& number : members.numbers)
+        {
+            if (member.first != number.first)
+            {
+                continue;
+            }
+            known = true;
+            if (member.second.type != Json_value::Type::number)
+            {
+                error = "input member '" + member.first + "' must be a number";
+                return false;
+            }
+            input.*number.second = member.second.number;
+        }
+        if (!known)
+        {
+            error = "unknown input member '" + member.first + "'";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Checks the members that both simulations need. Missing members keep their defaults, which are empty lists and
+// zeros, and the simulator does not check its input.
+template <typename Input>
+bool check_common_input(const Input& input, std::string& error)
+{
+    if (input.race.size() != 1)
+    {
+        error = "input member 'race' must name one race";
+    }
+    else if (!(input.fight_time > 0))
+    {
+        error = "input member 'fight_time' must be positive";
+    }
+    return error.empty();
+}
+
+// Rejects an input that the simulator can not run, read_input only checks the types of the members
+bool check_input(const Sim_input& input, std::string& error)
+{
+    if (!check_common_input(input, error))
+    {
+        return false;
+    }
+    if (input.armor.size() != 15)
+    {
+        error = "input member 'armor' must name 15 items, one per slot";
+    }
+    else if (input.weapons.size() != 2)
+    {
+        error = "input member 'weapons' must name the main hand and the off hand weapon";
+    }
+    else if (!(input.n_simulations >= 1))
+    {
+        error = "input member 'n_simulations' must be positive";
+    }
+    return error.empty();
+}
+
+// The optimizer pairs a main hand with a different off hand weapon, see Item_optimizer::compute_weapon_combinations.
+// Unknown weapons are skipped.
+bool has_weapon_pair(const std::vector<std::string>& weapon_names)
+{
+    Armory armory;
+    for (const auto& main_hand_name : weapon_names)
+    {
+        Weapon main_hand = armory.find_weapon(main_hand_name);
+        if (main_hand.name != main_hand_name || main_hand.weapon_socket == Weapon_socket::off_hand ||
+            main_hand.weapon_socket == Weapon_socket::two_hand)
+        {
+            continue;
+        }
+        for (const auto& off_hand_name : weapon_names)
+        {
+            Weapon off_hand = armory.find_weapon(off_hand_name);
+            bool fits_off_hand =
+                off_hand.weapon_socket == Weapon_socket::one_hand || off_hand.weapon_socket == Weapon_socket::off_hand;
+            if (off_hand.name == off_hand_name && off_hand_name != main_hand_name && fits_off_hand)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool check_input(const Sim_input_mult& input, std::string& error)
+{
+    if (!check_common_input(input, error))
+    {
+        return false;
+    }
+    if (input.armor.empty())
+    {
+        error = "input member 'armor' must name the items to choose from";
+    }
+    else if (!has_weapon_pair(input.weapons))
+    {
+        error = "input member 'weapons' must name a main hand and a different off hand weapon";
+    }
+    return error.empty();
+}
+
+// Writes the progress lines of --progress and stops a job once its error margin reaches max_error_margin
+bool on_progress(const Sim_progress& progress, size_t line_number, const Json_value* id, double max_error_margin,
+                 bool write_progress)
+{
+    if (write_progress)
+    {
+        std::ostringstream line;
+        write_member(line, "line", static_cast<int>(line_number), true);
+        if (id != nullptr)
+        {
+            write_member(line, "id", *id);
+        }
+        line << ",\"progress\":{";
+        write_member(line, "n_simulations", static_cast<double>(progress.n_simulations), true);
+        write_member(line, "dps_mean", progress.dps_mean);
+        write_member(line, "dps_error_margin", progress.dps_error_margin);
+        write_member(line, "n_keepers", static_cast<double>(progress.n_keepers));
+        write_member(line, "elapsed_time", progress.elapsed_time);
+        write_member(line, "remaining_time", progress.remaining_time);
+        write_member(line, "fraction_done", progress.fraction_done);
+        line << '}';
+        static std::mutex progress_mutex;
+        std::lock_guard<std::mutex> lock{progress_mutex};
+        std::cerr << "{" + line.str() + "}" << std::endl;
+    }
+    // A margin from a handful of fights is not trusted
+    constexpr size_t min_simulations = 100;
+    return progress.n_simulations < min_simulations || !(progress.dps_error_margin <= max_error_margin);
+}
+
+// Drops "multi_threaded" from the options, so that the job runs on the thread of its worker
+void remove_multi_threaded(std::vector<std::string>& options)
+{
+    options.erase(std::remove(options.begin(), options.end(), "multi_threaded"), options.end());
+}
+
+// Runs the job of one input line and returns its result line. Unless multi_threaded is set, the job is simulated on
+// the calling thread only.
+std::string run_job(const std::string& line, size_t line_number, bool write_progress, bool multi_threaded)
+{
+    std::ostringstream result;
+    write_member(result, "line", static_cast<int>(line_number), true);
+
+    Json_value job;
+    std::string error;
+    if (Json_parser{line}.parse(job, error) && job.type != Json_value::Type::object)
+    {
+        error = "the job must be an object";
+    }
+    if (error.empty())
+    {
+        const Json_value* id = job.find("id");
+        if (id != nullptr)
+        {
+            write_member(result, "id", *id);
+        }
+        const Json_value* type = job.find("type");
+        const Json_value* input = job.find("input");
+        const Json_value* max_error_margin = job.find("max_error_margin");
+        Sim_interface sim_interface;
+        sim_interface.set_progress_callback([&](const Sim_progress& progress) {
+            return on_progress(progress, line_number, id,
+                               (max_error_margin != nullptr) ? max_error_margin->number : 0.0, write_progress);
+        });
+        if (max_error_margin != nullptr && max_error_margin->type != Json_value::Type::number)
+        {
+            error = "'max_error_margin' must be a number";
+        }
+        else if (type == nullptr || type->type != Json_value::Type::string)
+        {
+            error = "missing 'type', expected \"simulate\" or \"simulate_mult\"";
+        }
+        else if (input == nullptr)
+        {
+            error = "missing 'input'";
+        }
+        else if (type->string == "simulate")
+        {
+            Sim_input sim_input;
+            if (read_input(*input, sim_input_members(), sim_input, error) && check_input(sim_input, error))
+            {
+                if (!multi_threaded)
+                {
+                    remove_multi_threaded(sim_input.options);
+                }
+                Sim_output output = sim_interface.simulate(sim_input);
+                write_member(result, "type", type->string);
+                result << ",\"output\":{";
+                write_member(result, "hist_x", output.hist_x, true);
+                write_member(result, "hist_y", output.hist_y);
+                write_member(result, "dmg_sources", output.dmg_sources);
+                write_member(result, "time_lapse_names", output.time_lapse_names);
+                write_member(result, "damage_time_lapse", output.damage_time_lapse);
+                write_member(result, "aura_uptimes", output.aura_uptimes);
+                write_member(result, "proc_counter", output.proc_counter);
+                write_member(result, "stat_weights", output.stat_weights);
+                write_member(result, "extra_stats", output.extra_stats);
+                write_member(result, "mean_dps", output.mean_dps);
+                write_member(result, "std_dps", output.std_dps);
+                write_member(result, "messages", output.messages);
+                result << '}';
+            }
+        }
+        else if (type->string == "simulate_mult")
+        {
+            Sim_input_mult sim_input;
+            if (read_input(*input, sim_input_mult_members(), sim_input, error) && check_input(sim_input, error))
+            {
+                if (!multi_threaded)
+                {
+                    remove_multi_threaded(sim_input.options);
+                }
+                Sim_output_mult output = sim_interface.simulate_mult(sim_input);
+                write_member(result, "type", type->string);
+                result << ",\"output\":{";
+                write_member(result, "messages", output.messages, true);
+                result << '}';
+            }
+        }
+        else
+        {
+            error = "unknown type '" + type->string + "', expected \"simulate\" or \"simulate_mult\"";
+        }
+    }
+    if (!error.empty())
+    {
+        write_member(result, "error", error);
+    }
+    return "{" + result.str() + "}";
+}
+
+void print_usage()
+{
+    std::cerr << "Usage: wow_cli [--jobs N] [--progress] [jobs.jsonl]\n"
+                 "Runs one simulation job per JSON line of the file, or of stdin when no file is given, and writes\n"
+                 "one JSON result line per job to stdout. --jobs sets the number of jobs run at the same time,\n"
+                 "the default is the number of cores. Each job then runs on one thread, and the \"multi_threaded\"\n"
+                 "option of a job is ignored unless --jobs is 1. --progress writes the progress of the jobs to\n"
+                 "stderr.\n";
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int n_workers = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+    const char* file_name = nullptr;
+    bool write_progress = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--progress") == 0)
+        {
+            write_progress = true;
+        }
+        else if (std::strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+        {
+            n_workers = std::atoi(argv[++i]);
+            if (n_workers < 1)
+            {
+                print_usage();
+                return 1;
+            }
+        }
+        else if (argv[i][0] == '-' && argv[i][1] != '\0')
+        {
+            print_usage();
+            return (std::strcmp(argv[i], "--help") == 0) ? 0 : 1;
+        }
+        else if (file_name == nullptr)
+        {
+            file_name = argv[i];
+        }
+        else
+        {
+            print_usage();
+            return 1;
+        }
+    }
+
+    std::ifstream file;
+    if (file_name != nullptr && std::strcmp(file_name, "-") != 0)
+    {
+        file.open(file_name);
+        if (!file)
+        {
+            std::cerr << "Could not open " << file_name << "\n";
+            return 1;
+        }
+    }
+    std::istream& jobs = file.is_open() ? file : std::cin;
+
+    // The simulator logs its progress to std::cout, which would mix with the results
+    std::ostream results{std::cout.rdbuf()};
+    std::cout.rdbuf(std::cerr.rdbuf());
+
+    // The workers take the next line themselves, so jobs are read as they are needed and a long stream of jobs is
+    // never held in memory
+    std::mutex input_mutex;
+    std::mutex output_mutex;
+    size_t n_lines = 0;
+    auto worker = [&]() {
+        while (true)
+        {
+            std::string line;
+            size_t line_number;
+            {
+                std::lock_guard<std::mutex> lock{input_mutex};
+                do
+                {
+                    if (!std::getline(jobs, line))
+                    {
+                        return;
+                    }
+                    line_number = ++n_lines;
+                } while (line.find_first_not_of(" \t\r") == std::string::npos);
+            }
+            std::string result = run_job(line, line_number, write_progress, n_workers == 1);
+            std::lock_guard<std::mutex> lock{output_mutex};
+            results << result << std::endl;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < n_workers; i++)
+    {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef WOW_SIMULATOR_TEST_HPP
+#define WOW_SIMULATOR_TEST_HPP
+
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Checks for the test executables. Failed checks are printed to stderr, and main returns
+// Test::exit_code() so that ctest sees the failure.
+namespace Test
+{
+inline int& n_failures()
+{
+    static int n = 0;
+    return n;
+}
+
+inline void check(bool condition, const std::string& message)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << message << "\n";
+        n_failures()++;
+    }
+}
+
+inline void check_near(double value, double expected, double tolerance, const std::string& message)
+{
+    std::ostringstream stream;
+    stream.precision(17);
+    stream << message << ": " << value << " is not within " << tolerance << " of " << expected;
+    check(std::abs(value - expected) <= tolerance, stream.str());
+}
+
+inline int exit_code()
+{
+    if (n_failures() == 0)
+    {
+        std::cout << "All checks passed\n";
+        return 0;
+    }
+    std::cerr << n_failures() << " checks failed\n";
+    return 1;
+}
+} // namespace Test
+
+#endif // WOW_SIMULATOR_TEST_HPP
@@ -0,0 +1,153 @@
+// The fight loop must not allocate: once a warm-up call has sized the buffers, the fights of later calls allocate
+// nothing. Every allocation of the process is counted by replacing the global operator new, and the fight loop is
+// delimited by the progress callback, which it calls every Combat_simulator::progress_interval fights.
+
+#include "Armory.hpp"
+#include "Combat_simulator.hpp"
+#include "Helper_functions.hpp"
+#include "Test.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+std::atomic<long> n_allocations{0};
+
+Character test_character(const Armory& armory)
+{
+    const std::vector<std::pair<Socket, std::string>> armor = {
+        {Socket::head, "lionheart_helm"},
+        {Socket::neck, "onyxia_tooth_pendant"},
+        {Socket::shoulder, "drake_talon_pauldrons"},
+        {Socket::back, "cape_of_the_black_baron"},
+        {Socket::chest, "savage_gladiator_chain"},
+        {Socket::wrist, "wristguards_of_stability"},
+        {Socket::hands, "flameguard_gauntlets"},
+        {Socket::belt, "onslaught_girdle"},
+        {Socket::legs, "cloudkeeper_legplates"},
+        {Socket::boots, "chromatic_boots"},
+        {Socket::ring, "might_of_cenarius"},
+        {Socket::ring, "master_dragonslayers_ring"},
+        {Socket::trinket, "badge_of_the_swarmguard"},
+        {Socket::trinket, "diamond_flask"},
+        {Socket::ranged, "blastershot"}};
+    auto character = get_character_of_race("orc");
+    for (const auto& item : armor)
+    {
+        character.equip_armor(armory.find_armor(item.first, item.second));
+    }
+    character.equip_weapon(armory.find_weapon("thunderfury_blessed_blade"),
+                           armory.find_weapon("dal_rends_tribal_guardian"));
+    armory.add_enchants_to_character(character, {"e+8 strength", "s+30 attack power", "mcrusader", "ocrusader"});
+    armory.add_buffs_to_character(character, {"rallying_cry", "dire_maul", "songflower", "warchiefs_blessing",
+                                              "spirit_of_zandalar", "sayges_fortune", "windfury_totem",
+                                              "blessing_of_kings", "mighty_rage_potion"});
+    armory.compute_total_stats(character);
+    return character;
+}
+
+Sim_input test_input(int n_simulations)
+{
+    return {{"orc"},
+            {},
+            {},
+            {},
+            {},
+            {},
+            {"faerie_fire", "recklessness", "enable_blood_fury", "curse_of_recklessness", "death_wish",
+             "use_bloodthirst", "use_whirlwind", "use_heroic_strike", "use_hamstring", "use_overpower",
+             "deep_wounds"},
+            {},
+            {},
+            60,
+            63,
+            static_cast<double>(n_simulations),
+            0,
+            5,
+            60,
+            60,
+            25,
+            1,
+            2.0,
+            80,
+            50,
+            2,
+            1.5,
+            45};
+}
+
+// Allocations in the fight loop of one simulate call of n_simulations fights, from the first to the last progress
+// callback. The setup of the call before its first fight and the normalization after its last are not counted.
+long count_fight_loop_allocations(Combat_simulator& simulator, const Character& character, int n_simulations,
+                                  bool compute_time_lapse)
+{
+    Combat_simulator_config config{test_input(n_simulations)};
+    simulator.set_config(config);
+    long first = 0;
+    long last = 0;
+    int n_callbacks = 0;
+    simulator.set_progress_callback([&first, &last, &n_callbacks](const Statistics::Running_statistics&) {
+        last = n_allocations;
+        first = n_callbacks++ == 0 ? last : first;
+        return true;
+    });
+    simulator.simulate(character, 0, compute_time_lapse, false);
+    Test::check(n_callbacks == n_simulations / Combat_simulator::progress_interval,
+                "the progress callback runs every progress_interval fights");
+    return last - first;
+}
+} // namespace
+
+void* operator new(size_t size)
+{
+    n_allocations++;
+    void* pointer = std::malloc(size > 0 ? size : 1);
+    if (pointer == nullptr)
+    {
+        throw std::bad_alloc{};
+    }
+    return pointer;
+}
+
+// GCC inlines the replacement operator delete into callers of operator new and then reports the std::free as a
+// mismatch. The replacements are a matched pair, operator new allocates with std::malloc.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+int main()
+{
+    Armory armory;
+    const Character character = test_character(armory);
+    constexpr int n_simulations = 500;
+
+    // The performance runs, as used for stat weights and the gear optimizer, and the runs with a time lapse
+    for (bool compute_time_lapse : {false, true})
+    {
+        Combat_simulator simulator;
+        long warm_up = count_fight_loop_allocations(simulator, character, n_simulations, compute_time_lapse);
+        long second = count_fight_loop_allocations(simulator, character, n_simulations, compute_time_lapse);
+        long longer = count_fight_loop_allocations(simulator, character, 10 * n_simulations, compute_time_lapse);
+        std::string run = compute_time_lapse ? "with time lapse" : "without time lapse";
+        std::cout << run << ": " << warm_up << " fight loop allocations in the warm-up, " << second
+                  << " in the second and " << longer << " in a 10 times longer call\n";
+        Test::check(second == 0, "the fight loop allocates after the warm-up, " + run);
+        Test::check(longer == 0, "the fight loop allocates in a longer call, " + run);
+    }
+    return Test::exit_code();
+}
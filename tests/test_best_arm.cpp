@@ -0,0 +1,136 @@
+// The optimizer's best arm identification on synthetic arms with paired normal samples: sample j of every arm shares
+// a common term, like fight j of every item set shares the fight's random streams. The error bound has to hold over
+// all rounds, so identical arms must rarely be separated however many rounds they run.
+
+#include "Best_arm_identification.hpp"
+#include "Random_engine.hpp"
+#include "Test.hpp"
+
+#include <algorithm>
+#include <random>
+
+namespace
+{
+constexpr size_t first_block_size = 10;
+constexpr double block_growth = 1.2;
+constexpr size_t n_blocks = 30;
+
+struct Trial_result
+{
+    Best_arm_identification::State state;
+    std::vector<size_t> arms;
+    size_t n_rounds;
+};
+
+// Runs the rounds until the arms are separated or out of samples. Sample j of arm a is
+// means[a] + common_j + noise_aj, with normal common and noise terms.
+Trial_result run_trial(const std::vector<double>& means, double confidence, size_t min_kept_arms, uint64_t seed)
+{
+    constexpr double common_deviation = 50;
+    constexpr double noise_deviation = 10;
+    Best_arm_identification best_arm{means.size(), confidence, min_kept_arms, first_block_size, block_growth, n_blocks};
+
+    std::normal_distribution<double> normal;
+    Xoshiro256_plus common_engine{seed, means.size()};
+    std::vector<double> common(best_arm.get_block_start(n_blocks));
+    for (auto& value : common)
+    {
+        value = common_deviation * normal(common_engine);
+    }
+    std::vector<Xoshiro256_plus> noise_engines;
+    for (size_t arm = 0; arm < means.size(); arm++)
+    {
+        noise_engines.emplace_back(seed, arm);
+    }
+
+    auto state = Best_arm_identification::State::running;
+    std::vector<double> samples;
+    while (state == Best_arm_identification::State::running)
+    {
+        for (auto arm : best_arm.get_sampled_arms())
+        {
+            samples.clear();
+            for (size_t j = best_arm.get_n_samples(arm); j < best_arm.get_target_samples(); j++)
+            {
+                samples.push_back(means[arm] + common[j] + noise_deviation * normal(noise_engines[arm]));
+            }
+            best_arm.add_samples(arm, samples);
+        }
+        state = best_arm.finish_round();
+    }
+    return {state, best_arm.get_arms(), best_arm.get_round()};
+}
+
+bool contains(const std::vector<size_t>& arms, size_t arm)
+{
+    return std::find(arms.begin(), arms.end(), arm) != arms.end();
+}
+
+void test_block_schedule()
+{
+    Best_arm_identification best_arm{2, 0.9, 1, first_block_size, block_growth, n_blocks};
+    Test::check(best_arm.get_block_size(0) == 10 && best_arm.get_block_size(1) == 12, "the second block is larger");
+    Test::check(best_arm.get_block_size(2) == 14, "block sizes are rounded down");
+    Test::check(best_arm.get_block_start(3) == 36, "blocks start after the earlier blocks");
+    Test::check(best_arm.get_block(0) == 0 && best_arm.get_block(36) == 3, "block of a block start");
+    Test::check(best_arm.get_target_block() == 1 && best_arm.get_sampled_arms().size() == 2,
+                "the first round samples the first block of every arm");
+}
+
+void test_clear_winner()
+{
+    std::vector<double> means;
+    for (size_t arm = 0; arm < 10; arm++)
+    {
+        means.push_back(100 - 2.0 * static_cast<double>(arm));
+    }
+    std::swap(means[0], means[7]);
+    auto result = run_trial(means, 0.99, 3, 1);
+    Test::check(result.state == Best_arm_identification::State::separated, "a clear winner is separated");
+    Test::check(result.arms.size() == 3 && result.arms.front() == 7, "the best arm leads the kept arms");
+}
+
+// With identical arms every arm is a best arm, so removing arm 0 is an error. Testing once per round without
+// splitting the error over the rounds removes it far more often than the bound allows.
+void test_identical_arms()
+{
+    constexpr size_t n_trials = 200;
+    constexpr double confidence = 0.9;
+    size_t n_errors = 0;
+    size_t n_rounds = 0;
+    for (size_t trial = 0; trial < n_trials; trial++)
+    {
+        auto result = run_trial(std::vector<double>(5, 100), confidence, 1, 1000 + trial);
+        n_errors += !contains(result.arms, 0);
+        n_rounds += result.n_rounds;
+    }
+    std::cout << "Identical arms: " << n_errors << " of " << n_trials << " trials removed arm 0, "
+              << static_cast<double>(n_rounds) / n_trials << " rounds per trial\n";
+    Test::check(n_errors <= (1 - confidence) * n_trials, "a best arm is removed within the error bound");
+}
+
+// The best arm is ahead by a tenth of the noise deviation, so most trials end before separating the arms. It must
+// not be removed more often than the error bound allows.
+void test_close_arms()
+{
+    constexpr size_t n_trials = 200;
+    constexpr double confidence = 0.9;
+    size_t n_errors = 0;
+    for (size_t trial = 0; trial < n_trials; trial++)
+    {
+        auto result = run_trial({100, 100, 101, 100, 100}, confidence, 1, 2000 + trial);
+        n_errors += !contains(result.arms, 2);
+    }
+    std::cout << "Close arms: " << n_errors << " of " << n_trials << " trials removed the best arm\n";
+    Test::check(n_errors <= (1 - confidence) * n_trials, "the best arm is removed within the error bound");
+}
+} // namespace
+
+int main()
+{
+    test_block_schedule();
+    test_clear_winner();
+    test_identical_arms();
+    test_close_arms();
+    return Test::exit_code();
+}
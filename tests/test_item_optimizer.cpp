@@ -0,0 +1,122 @@
+// The AP equivalent prefilter of the gear optimizer. The streamed AP equivalents of compute_ap_equivalents must
+// match the ones of the constructed characters, and serve as the exhaustive reference for the branch and bound search
+// of find_best_ap_equivalents, which must find exactly the best sets.
+
+#include "Item_optimizer.hpp"
+#include "Test.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace
+{
+// Two raid tiers of armor, where the AQ40 set pieces give set bonuses, the trinkets give use effects and the hand
+// slot includes weapon skill. The weapons mix weapon types and hit effects.
+void setup_optimizer(Item_optimizer& item_optimizer)
+{
+    const std::vector<std::string> armor = {
+        "lionheart_helm", "conquerors_crown", "onyxia_tooth_pendant", "barbed_choker", "drake_talon_pauldrons",
+        "conquerors_spaulders", "cape_of_the_black_baron", "cloak_of_the_shrouded_mists", "savage_gladiator_chain",
+        "conquerors_breastplate", "wristguards_of_stability", "hive_defiler_wristguards", "flameguard_gauntlets",
+        "gauntlets_of_annihilation", "edgemasters_handguards", "onslaught_girdle", "cloudkeeper_legplates",
+        "conquerors_legguards", "chromatic_boots", "might_of_cenarius", "master_dragonslayers_ring",
+        "quick_strike_ring", "circle_of_applied_force", "badge_of_the_swarmguard", "diamond_flask", "jom_gabbar",
+        "larvae_of_the_great_worm", "blastershot"};
+    const std::vector<std::string> weapons = {"thunderfury_blessed_blade", "dal_rends_tribal_guardian",
+                                              "brutality_blade"};
+    item_optimizer.race = get_race("orc");
+    item_optimizer.buffs_vec = {"rallying_cry", "dire_maul", "songflower", "warchiefs_blessing", "blessing_of_kings"};
+    item_optimizer.ench_vec = {"e+8 strength", "s+30 attack power", "mcrusader", "ocrusader"};
+    item_optimizer.item_setup(armor, weapons);
+    item_optimizer.compute_combinations();
+    item_optimizer.sim_time = 60;
+
+    // As in simulate_mult, only the strongest of the use effects with a shared cooldown counts
+    std::string debug_message;
+    item_optimizer.find_best_use_effect(item_optimizer.construct(0).total_special_stats, debug_message);
+}
+
+// The AP equivalent of every set, from constructing its character
+std::vector<double> constructed_ap_equivalents(Item_optimizer& item_optimizer)
+{
+    std::vector<double> ap_equivalents;
+    ap_equivalents.reserve(item_optimizer.total_combinations);
+    for (size_t index = 0; index < item_optimizer.total_combinations; ++index)
+    {
+        Character character = item_optimizer.construct(index);
+        ap_equivalents.push_back(item_optimizer.get_total_qp_equivalent(
+            character.total_special_stats, character.weapons[0], character.weapons[1], character.use_effects));
+    }
+    return ap_equivalents;
+}
+
+void test_streamed_ap_equivalents(Item_optimizer& item_optimizer, const std::vector<double>& ap_equivalents)
+{
+    const std::vector<double> constructed = constructed_ap_equivalents(item_optimizer);
+    Test::check(ap_equivalents.size() == constructed.size(), "an AP equivalent per set");
+    size_t n_mismatches = 0;
+    for (size_t index = 0; index < std::min(ap_equivalents.size(), constructed.size()); ++index)
+    {
+        n_mismatches += std::abs(ap_equivalents[index] - constructed[index]) > 1e-9 * std::abs(constructed[index]);
+    }
+    std::cout << item_optimizer.total_combinations << " sets, " << n_mismatches
+              << " streamed AP equivalents differ from the constructed ones\n";
+    Test::check(n_mismatches == 0, "the streamed AP equivalents match the constructed characters");
+}
+
+// The search prunes with an upper bound that has to hold under the stat caps, for set bonuses that can still be
+// completed and for every weapon skill the remaining slots can reach. A bound that is too low for some subtree
+// loses sets from it, so the best sets found must be the best sets of the full pass.
+void test_best_ap_equivalents(Item_optimizer& item_optimizer, const std::vector<double>& ap_equivalents)
+{
+    std::vector<double> sorted_ap_equivalents = ap_equivalents;
+    std::sort(sorted_ap_equivalents.begin(), sorted_ap_equivalents.end(), std::greater<double>());
+    const size_t n_sets = ap_equivalents.size();
+    for (size_t n_best : {size_t{1}, size_t{2}, size_t{10}, size_t{100}, size_t{1000}, size_t{10000}, n_sets - 1,
+                          n_sets, n_sets + 1})
+    {
+        const std::string run = std::to_string(n_best) + " best sets";
+        std::string debug_message;
+        const std::vector<Item_optimizer::Sim_result_t> best =
+            item_optimizer.find_best_ap_equivalents(n_best, debug_message);
+        Test::check(best.size() == std::min(n_best, n_sets), "number of sets, " + run);
+
+        bool in_index_order = true;
+        bool matches_full_pass = true;
+        std::vector<double> best_ap_equivalents;
+        for (size_t i = 0; i < best.size(); ++i)
+        {
+            in_index_order = in_index_order && (i == 0 || best[i - 1].index < best[i].index);
+            matches_full_pass = matches_full_pass && best[i].index < n_sets &&
+                                std::abs(best[i].ap_equivalent - ap_equivalents[best[i].index]) <=
+                                    1e-9 * std::abs(ap_equivalents[best[i].index]);
+            best_ap_equivalents.push_back(best[i].ap_equivalent);
+        }
+        Test::check(in_index_order, "distinct sets in index order, " + run);
+        Test::check(matches_full_pass, "AP equivalents of the full pass, " + run);
+
+        // Compared by value, since sets with equal AP equivalents may tie for the last place
+        std::sort(best_ap_equivalents.begin(), best_ap_equivalents.end(), std::greater<double>());
+        bool is_top = true;
+        for (size_t i = 0; i < best_ap_equivalents.size(); ++i)
+        {
+            is_top = is_top && std::abs(best_ap_equivalents[i] - sorted_ap_equivalents[i]) <=
+                                   1e-9 * std::abs(sorted_ap_equivalents[i]);
+        }
+        Test::check(is_top, "the best sets of the full pass, " + run);
+    }
+}
+} // namespace
+
+int main()
+{
+    Item_optimizer item_optimizer;
+    setup_optimizer(item_optimizer);
+    const std::vector<double> ap_equivalents = item_optimizer.compute_ap_equivalents();
+    test_streamed_ap_equivalents(item_optimizer, ap_equivalents);
+    test_best_ap_equivalents(item_optimizer, ap_equivalents);
+    return Test::exit_code();
+}
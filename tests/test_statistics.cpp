@@ -0,0 +1,118 @@
+// The statistics behind the reported error margins: known quantiles of the normal and Student's t distributions, the
+// merge of running statistics, and the quantile bound, merge and text form of the quantile sketch.
+
+#include "Random_engine.hpp"
+#include "Statistics.hpp"
+#include "Test.hpp"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+void test_quantiles()
+{
+    Test::check_near(Statistics::inverse_normal_cdf(0.975), 1.959963984540054, 1e-15, "normal quantile");
+    Test::check_near(Statistics::inverse_normal_cdf(0.025), -1.959963984540054, 1e-15, "lower normal quantile");
+    Test::check_near(Statistics::inverse_normal_cdf(0.5), 0.0, 1e-15, "normal median");
+
+    // One and two degrees of freedom have closed forms, the others are tabulated values
+    const std::vector<std::pair<double, double>> t_quantiles = {
+        {1, 12.706204736174698}, {2, 4.302652729749464}, {10, 2.2281388519649385}, {1e5, 1.9599877075346095}};
+    for (const auto& t_quantile : t_quantiles)
+    {
+        Test::check_near(Statistics::student_t_quantile(0.975, t_quantile.first), t_quantile.second,
+                         1e-7 * t_quantile.second, "t quantile with " + std::to_string(t_quantile.first) + " df");
+        Test::check_near(Statistics::student_t_quantile(0.025, t_quantile.first), -t_quantile.second,
+                         1e-7 * t_quantile.second, "lower t quantile with " + std::to_string(t_quantile.first) + " df");
+    }
+}
+
+std::vector<double> dps_samples(size_t n_samples)
+{
+    Xoshiro256_plus engine{17, 0};
+    std::normal_distribution<double> normal{1200, 150};
+    std::vector<double> samples(n_samples);
+    for (auto& sample : samples)
+    {
+        sample = std::max(normal(engine), 0.0);
+    }
+    return samples;
+}
+
+// Running statistics of disjoint parts merge into the statistics of all samples
+void test_running_statistics()
+{
+    const auto samples = dps_samples(10000);
+    Statistics::Running_statistics all;
+    std::vector<Statistics::Running_statistics> parts(3);
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        all.push(samples[i]);
+        parts[i * 3 / samples.size()].push(samples[i]);
+    }
+    Statistics::Running_statistics merged;
+    merged.merge(Statistics::Running_statistics{});
+    for (const auto& part : parts)
+    {
+        merged.merge(part);
+    }
+    double mean = Statistics::average(samples);
+    Test::check(merged.get_count() == samples.size(), "merged count");
+    Test::check_near(all.get_mean(), mean, 1e-9, "running mean");
+    Test::check_near(all.get_variance(), Statistics::variance(samples, mean), 1e-6, "running variance");
+    Test::check_near(merged.get_mean(), all.get_mean(), 1e-9, "merged mean");
+    Test::check_near(merged.get_variance(), all.get_variance(), 1e-6, "merged variance");
+
+    Statistics::Running_statistics restored;
+    Test::check(restored.deserialize(merged.serialize()), "running statistics deserialize");
+    Test::check(restored.get_count() == merged.get_count() && restored.get_mean() == merged.get_mean() &&
+                    restored.get_variance() == merged.get_variance(),
+                "running statistics round trip");
+    Test::check(!restored.deserialize("not statistics") && restored.get_count() == merged.get_count(),
+                "malformed running statistics are rejected");
+}
+
+// Every quantile of the sketch is within the relative accuracy of the exact sample quantile
+void test_quantile_sketch()
+{
+    constexpr double relative_accuracy = 0.001;
+    auto samples = dps_samples(20000);
+    Statistics::Quantile_sketch sketch{relative_accuracy};
+    Statistics::Quantile_sketch first_half{relative_accuracy};
+    Statistics::Quantile_sketch second_half{relative_accuracy};
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        sketch.push(samples[i]);
+        (i < samples.size() / 2 ? first_half : second_half).push(samples[i]);
+    }
+    std::sort(samples.begin(), samples.end());
+    for (double quantile : {0.0, 0.01, 0.25, 0.5, 0.9, 0.99, 1.0})
+    {
+        double exact = samples[static_cast<size_t>(quantile * static_cast<double>(samples.size() - 1))];
+        Test::check_near(sketch.get_quantile(quantile), exact, relative_accuracy * exact,
+                         "sketch quantile " + std::to_string(quantile));
+    }
+
+    first_half.merge(second_half);
+    Test::check(first_half.serialize() == sketch.serialize(), "merged halves equal the sketch of all samples");
+
+    Statistics::Quantile_sketch restored{relative_accuracy};
+    Test::check(restored.deserialize(sketch.serialize()), "sketch deserialize");
+    Test::check(restored.serialize() == sketch.serialize() && restored.get_quantile(0.5) == sketch.get_quantile(0.5),
+                "sketch round trip");
+    Test::check(!restored.deserialize("1 2 x") && restored.get_count() == sketch.get_count(),
+                "malformed sketches are rejected");
+}
+} // namespace
+
+int main()
+{
+    test_quantiles();
+    test_running_statistics();
+    test_quantile_sketch();
+    return Test::exit_code();
+}
@@ -0,0 +1,82 @@
+#ifndef WOW_SIMULATOR_BEST_ARM_IDENTIFICATION_HPP
+#define WOW_SIMULATOR_BEST_ARM_IDENTIFICATION_HPP
+
+#include "Statistics.hpp"
+
+#include <cstddef>
+#include <vector>
+
+// Finds the arm with the highest mean among arms with paired samples, sample j of every arm is drawn under the same
+// conditions (for the optimizer: the same fight). The samples are drawn in blocks of growing size. Each round, the
+// leader and the less separated half of the challengers advance one block past the furthest of them, the other
+// challengers wait. A challenger is removed once a paired t-test on its difference to the leader separates them.
+//
+// The test is repeated every round on the growing samples, so the error is split over the rounds as well as over the
+// challengers: round r removes with an error of (1 - confidence) / ((n_arms - 1) r (r + 1)). The shares sum to
+// 1 - confidence over all rounds, which bounds the chance that the best arm is ever removed however long it runs.
+class Best_arm_identification
+{
+public:
+    enum class State
+    {
+        running,
+        separated,
+        out_of_samples,
+    };
+
+    // The first block has first_block_size samples, every next block is block_growth times larger. Arms sorted below
+    // the first min_kept_arms are removed only when separated from the leader.
+    Best_arm_identification(size_t n_arms, double confidence, size_t min_kept_arms, size_t first_block_size,
+                            double block_growth, size_t n_blocks);
+
+    // Arms to sample this round, each from block get_block(get_n_samples(arm)) up to but not including
+    // get_target_block()
+    const std::vector<size_t>& get_sampled_arms() const { return sampled_arms_; }
+
+    size_t get_target_block() const { return target_block_; }
+
+    size_t get_target_samples() const { return block_starts_[target_block_]; }
+
+    // Block containing sample n_samples, or the block starting there
+    size_t get_block(size_t n_samples) const;
+
+    size_t get_block_start(size_t block) const { return block_starts_[block]; }
+
+    size_t get_block_size(size_t block) const { return block_starts_[block + 1] - block_starts_[block]; }
+
+    // Appends the next samples of an arm. Different arms may be added from different threads.
+    void add_samples(size_t arm, const std::vector<double>& samples);
+
+    // Removes the challengers separated from the leader and picks the arms of the next round
+    State finish_round();
+
+    // Arms still in the running, the leader first and the rest by falling mean after finish_round
+    const std::vector<size_t>& get_arms() const { return arms_; }
+
+    const Statistics::Running_statistics& get_statistics(size_t arm) const { return statistics_[arm]; }
+
+    size_t get_n_samples(size_t arm) const { return samples_[arm].size(); }
+
+    // Samples drawn over all arms, including the removed ones
+    size_t get_total_samples() const;
+
+    // Rounds finished so far
+    size_t get_round() const { return round_; }
+
+    // Confidence of the removals in the last finished round
+    double get_round_confidence() const { return round_confidence_; }
+
+private:
+    double confidence_;
+    size_t min_kept_arms_;
+    std::vector<size_t> block_starts_;
+    std::vector<std::vector<double>> samples_;
+    std::vector<Statistics::Running_statistics> statistics_;
+    std::vector<size_t> arms_;
+    std::vector<size_t> sampled_arms_;
+    size_t target_block_{1};
+    size_t round_{};
+    double round_confidence_{};
+};
+
+#endif // WOW_SIMULATOR_BEST_ARM_IDENTIFICATION_HPP
@@ -4,15 +4,17 @@
 #include "Attributes.hpp"
 #include "Item.hpp"
 
+#include <algorithm>
 #include <cmath>
 #include <unordered_map>
 #include <vector>
 
 struct Over_time_buff
 {
-    Over_time_buff(std::string id, Special_stats special_stats, int init_time, double rage_gain, double damage,
+    Over_time_buff(int id, int key, Special_stats special_stats, int init_time, double rage_gain, double damage,
                    int interval, int duration)
-        : id(std::move(id))
+        : id(id)
+        , key(key)
         , special_stats(special_stats)
         , init_time(init_time)
         , total_ticks(duration / interval)
@@ -21,7 +23,10 @@ struct Over_time_buff
         , damage(damage)
         , interval(interval){};
 
-    std::string id;
+    constexpr double next_tick() const { return init_time + current_ticks * interval; }
+
+    int id;
+    int key;
     Special_stats special_stats;
     int init_time;
     int total_ticks;
@@ -33,214 +38,315 @@ struct Over_time_buff
 
 struct Combat_buff
 {
-    Combat_buff(std::string id, Special_stats special_stats, double duration_left)
-        : id(std::move(id)), special_stats(special_stats), duration_left(duration_left){};
+    Combat_buff(int id, int key, Special_stats special_stats, double start_time, double end_time)
+        : id(id), key(key), special_stats(special_stats), start_time(start_time), end_time(end_time){};
 
-    std::string id;
+    int id;
+    int key;
     Special_stats special_stats;
-    double duration_left;
+    double start_time;
+    double end_time;
 };
 
 struct Hit_buff
 {
-    Hit_buff(std::string id, double duration_left) : id(std::move(id)), duration_left(duration_left){};
+    Hit_buff(int id, int key, const Hit_effect* hit_effect, double start_time, double end_time)
+        : id(id), key(key), hit_effect(hit_effect), start_time(start_time), end_time(end_time){};
 
-    std::string id;
-    double duration_left;
+    int id;
+    int key;
+    const Hit_effect* hit_effect;
+    double start_time;
+    double end_time;
 };
 
-struct Aura_uptime
+// Timestamped buff fade or over time tick. Events are never removed from the queue when a buff is refreshed or
+// removed. Instead, they refer to the buff by its key and are discarded when popped if they no longer match it.
+struct Buff_event
 {
-    Aura_uptime() = default;
-
-    struct Aura
+    enum class Type
     {
-        Aura(std::string id, double duration) : id(std::move(id)), duration(duration){};
+        stat_fade,
+        hit_fade,
+        over_time_tick,
+    };
+
+    Buff_event(double time, Type type, int key) : time(time), type(type), key(key){};
+
+    constexpr bool operator>(const Buff_event& other) const { return time > other.time; }
+
+    double time;
+    Type type;
+    int key;
+};
 
-        std::string id;
-        double duration;
+// Buffs, procs and auras are referred to by small integer ids while simulating. Names are resolved to ids when the
+// simulation is set up, and only looked up again for debug messages and statistics.
+class Buff_manager
+{
+public:
+    // Buffs that the simulator refers to directly. Registered in this order by the constructor.
+    enum Builtin_id : int
+    {
+        overpower_aura,
+        battle_stance,
+        execute_rage_batch,
+        sulfuron_demo_shout,
+        deep_wounds,
     };
 
-    void add(const std::string& name, double duration)
+    Buff_manager()
+    {
+        for (const char* name :
+             {"overpower_aura", "battle_stance", "execute_rage_batch", "sulfuron_demo_shout", "Deep_wounds"})
+        {
+            get_id(name);
+        }
+    }
+
+    int get_id(const std::string& name)
     {
-        for (auto& aura : auras)
+        for (size_t i = 0; i < names.size(); i++)
         {
-            if (name == aura.id)
+            if (name == names[i])
             {
-                aura.duration += duration;
-                return;
+                return static_cast<int>(i);
             }
         }
-        auras.emplace_back(name, duration);
+        names.emplace_back(name);
+        aura_uptime.emplace_back(0.0);
+        procs.emplace_back(0);
+        active.emplace_back(false);
+        return static_cast<int>(names.size() - 1);
     }
 
-    std::vector<Aura> auras;
-};
-
-class Buff_manager
-{
-public:
-    struct Proc
-    {
-        Proc(std::string id, int counter) : id(std::move(id)), counter(counter){};
+    const std::string& get_name(int id) const { return names[id]; }
 
-        std::string id;
-        int counter;
-    };
+    void reset_aura_uptime() { std::fill(aura_uptime.begin(), aura_uptime.end(), 0.0); }
 
     void initialize(Special_stats& special_stats, const std::vector<Use_effect>& use_effects_input,
-                    std::vector<Hit_effect>& hit_effects_mh_input, std::vector<Hit_effect>& hit_effects_oh_input,
                     bool performance_mode_in)
     {
         performance_mode = performance_mode_in;
         stat_gains.clear();
         hit_gains.clear();
+        std::fill(active.begin(), active.end(), false);
         over_time_buffs.clear();
+        events.clear();
+        next_key = 0;
+        current_time = 0.0;
         simulation_special_stats = &special_stats;
-        hit_effects_mh = &hit_effects_mh_input;
-        hit_effects_oh = &hit_effects_oh_input;
-        use_effects = use_effects_input;
+        use_effects = &use_effects_input;
+        pending_use_effects.clear();
+        use_effects_window = 0.0;
+        for (size_t i = 0; i < use_effects_input.size(); i++)
+        {
+            pending_use_effects.push_back(i);
+            use_effects_window = std::max(use_effects_window, use_effects_input[i].duration + 1.5);
+        }
         deep_wounds_damage = 0.0;
         rage_spent_executing = 0.0;
         deep_wounds_timestamps.clear();
     };
 
-    double get_dt(double sim_time)
+    // Timestamp of the next buff fade or over time tick
+    double next_event_time() const { return events.empty() ? 1e10 : events.front().time; }
+
+    template <bool debug>
+    void increment(double time, double time_left, double& rage, double& rage_lost_stance, double& rage_lost_exec,
+                   double& global_cooldown_ready, std::vector<std::string>& status)
     {
-        double dt = 1e10;
-        dt = std::min(dt, next_event);
-        double interval_dt = double(min_interval) - std::fmod(sim_time, double(min_interval));
-        dt = std::min(dt, interval_dt);
-        return dt;
+        current_time = time;
+        while (!events.empty() && events.front().time <= current_time)
+        {
+            Buff_event event = events.front();
+            std::pop_heap(events.begin(), events.end(), std::greater<Buff_event>());
+            events.pop_back();
+            switch (event.type)
+            {
+            case Buff_event::Type::stat_fade:
+                fade_stat_gain<debug>(event, rage, rage_lost_stance, rage_lost_exec, status);
+                break;
+            case Buff_event::Type::hit_fade:
+                fade_hit_gain<debug>(event, status);
+                break;
+            case Buff_event::Type::over_time_tick:
+                tick_over_time_buff<debug>(event, rage, status);
+                break;
+            }
+        }
+        if (time_left < use_effects_window)
+        {
+            activate_use_effects<debug>(time_left, rage, global_cooldown_ready, status);
+        }
     }
 
-    void increment(double dt, double current_time, double time_left, double& rage, double& rage_lost_stance,
-                   double& rage_lost_exec, double& global_cooldown, std::vector<std::string>& status, bool debug)
+    // Accounts for the uptime of the auras that are still active when the fight ends
+    void finalize(double end_time)
     {
-        size_t i = 0;
-        next_event = 10;
-        while (i < stat_gains.size())
+        if (!performance_mode)
         {
-            if (!performance_mode)
+            for (const auto& gain : stat_gains)
             {
-                aura_uptime.add(stat_gains[i].id, dt);
+                aura_uptime[gain.id] += std::min(end_time, gain.end_time) - gain.start_time;
             }
-            stat_gains[i].duration_left -= dt;
-            if (stat_gains[i].duration_left < 0.0)
+            for (const auto& gain : hit_gains)
             {
-                if (debug)
-                {
-                    status.emplace_back(stat_gains[i].id + " fades.");
-                }
-                if (stat_gains[i].id == "battle_stance")
-                {
-                    if (rage > 25.0)
-                    {
-                        rage_lost_stance += rage - 25;
-                        rage = 25;
-                    }
-                }
-                else if (stat_gains[i].id == "execute_rage_batch")
-                {
-                    if (rage > rage_before_execute)
-                    {
-                        rage_lost_exec += rage - rage_before_execute;
-                    }
-                    rage_spent_executing += rage;
-                    rage = 0;
-                    status.emplace_back("Current rage: 0");
-                }
-                if (stat_gains[i].special_stats.hit > 0.0 || stat_gains[i].special_stats.critical_strike > 0.0)
+                aura_uptime[gain.id] += std::min(end_time, gain.end_time) - gain.start_time;
+            }
+        }
+    }
+
+    void add(int id, const Special_stats& special_stats, double duration_left)
+    {
+        double end_time = current_time + duration_left;
+        if (active[id])
+        {
+            for (auto& gain : stat_gains)
+            {
+                if (id == gain.id)
                 {
-                    need_to_recompute_hittables = true;
+                    gain.end_time = end_time;
+                    schedule(end_time, Buff_event::Type::stat_fade, gain.key);
+                    return;
                 }
-                (*simulation_special_stats) -= stat_gains[i].special_stats;
-                stat_gains.erase(stat_gains.begin() + i);
             }
-            else
+        }
+        (*simulation_special_stats) += special_stats;
+        if (special_stats.hit > 0.0 || special_stats.critical_strike > 0.0)
+        {
+            need_to_recompute_hittables = true;
+        }
+        active[id] = true;
+        stat_gains.emplace_back(id, next_key, special_stats, current_time, end_time);
+        schedule(end_time, Buff_event::Type::stat_fade, next_key++);
+    }
+
+    // The hit effect procs on both weapons while the buff is active. It must outlive the simulation.
+    void add_hit_effect(int id, const Hit_effect& hit_effect, double duration_left)
+    {
+        hit_gains.emplace_back(id, next_key, &hit_effect, current_time, current_time + duration_left);
+        schedule(current_time + duration_left, Buff_event::Type::hit_fade, next_key++);
+    }
+
+    void add_over_time_effect(const Over_time_effect& over_time_effect, int init_time)
+    {
+        if (over_time_effect.id == deep_wounds)
+        {
+            for (auto& over_time_buff : over_time_buffs)
             {
-                next_event = std::min(next_event, stat_gains[i].duration_left);
-                ++i;
+                if (over_time_buff.id == deep_wounds)
+                {
+                    over_time_buff.damage = std::max(over_time_effect.damage, over_time_buff.damage);
+                    over_time_buff.total_ticks =
+                        (over_time_effect.duration + init_time - over_time_buff.init_time) / over_time_buff.interval;
+                    return;
+                }
             }
         }
-        i = 0;
-        while (i < hit_gains.size())
+        over_time_buffs.emplace_back(over_time_effect.id, next_key, over_time_effect.special_stats, init_time,
+                                     over_time_effect.rage_gain, over_time_effect.damage, over_time_effect.interval,
+                                     over_time_effect.duration);
+        schedule(over_time_buffs.back().next_tick(), Buff_event::Type::over_time_tick, next_key++);
+    }
+
+    void increment_proc(int id, int count = 1) { procs[id] += count; }
+
+    bool can_do_overpower() const { return active[overpower_aura]; }
+
+    void schedule(double time, Buff_event::Type type, int key)
+    {
+        events.emplace_back(time, type, key);
+        std::push_heap(events.begin(), events.end(), std::greater<Buff_event>());
+    }
+
+    template <bool debug>
+    void fade_stat_gain(const Buff_event& event, double& rage, double& rage_lost_stance, double& rage_lost_exec,
+                        std::vector<std::string>& status)
+    {
+        for (size_t i = 0; i < stat_gains.size(); i++)
         {
+            if (stat_gains[i].key != event.key)
+            {
+                continue;
+            }
+            if (stat_gains[i].end_time != event.time)
+            {
+                // The buff has been refreshed, a later event will make it fade
+                return;
+            }
             if (!performance_mode)
             {
-                aura_uptime.add(hit_gains[i].id, dt);
+                aura_uptime[stat_gains[i].id] += stat_gains[i].end_time - stat_gains[i].start_time;
             }
-            hit_gains[i].duration_left -= dt;
-            if (hit_gains[i].duration_left < 0.0)
+            if (debug)
             {
-                if (debug)
+                status.emplace_back(names[stat_gains[i].id] + " fades.");
+            }
+            if (stat_gains[i].id == battle_stance)
+            {
+                if (rage > 25.0)
                 {
-                    status.emplace_back(hit_gains[i].id + " fades.");
+                    rage_lost_stance += rage - 25;
+                    rage = 25;
                 }
-                for (size_t j = 0; j < (*hit_effects_mh).size(); j++)
+            }
+            else if (stat_gains[i].id == execute_rage_batch)
+            {
+                if (rage > rage_before_execute)
                 {
-                    if (hit_gains[i].id == (*hit_effects_mh)[j].name)
-                    {
-                        (*hit_effects_mh).erase((*hit_effects_mh).begin() + j);
-                    }
+                    rage_lost_exec += rage - rage_before_execute;
                 }
-                for (size_t j = 0; j < (*hit_effects_oh).size(); j++)
+                rage_spent_executing += rage;
+                rage = 0;
+                if (debug)
                 {
-                    if (hit_gains[i].id == (*hit_effects_oh)[j].name)
-                    {
-                        (*hit_effects_oh).erase((*hit_effects_oh).begin() + i);
-                    }
+                    status.emplace_back("Current rage: 0");
                 }
-                hit_gains.erase(hit_gains.begin() + i);
             }
-            else
+            if (stat_gains[i].special_stats.hit > 0.0 || stat_gains[i].special_stats.critical_strike > 0.0)
             {
-                next_event = std::min(next_event, hit_gains[i].duration_left);
-                ++i;
+                need_to_recompute_hittables = true;
             }
+            (*simulation_special_stats) -= stat_gains[i].special_stats;
+            active[stat_gains[i].id] = false;
+            stat_gains.erase(stat_gains.begin() + i);
+            return;
         }
-        i = 0;
-        while (i < use_effects.size())
+    }
+
+    template <bool debug>
+    void fade_hit_gain(const Buff_event& event, std::vector<std::string>& status)
+    {
+        for (size_t i = 0; i < hit_gains.size(); i++)
         {
-            if (time_left - use_effects[i].duration - 1.5 < 0.0 && global_cooldown < 0.0 &&
-                rage >= -use_effects[i].rage_boost)
+            if (hit_gains[i].key != event.key)
             {
-                if (debug)
-                {
-                    status.emplace_back("Activating: " + use_effects[i].name);
-                }
-                if (!use_effects[i].hit_effects.empty())
-                {
-                    add_hit_effect(use_effects[i].name, use_effects[i].hit_effects[0],
-                                   use_effects[i].hit_effects[0].duration);
-                }
-                else if (!use_effects[i].over_time_effects.empty())
-                {
-                    add_over_time_effect(use_effects[i].over_time_effects[0], int(current_time + 1));
-                }
-                else
-                {
-                    add(use_effects[i].name, use_effects[i].get_special_stat_equivalent(*simulation_special_stats),
-                        use_effects[i].duration);
-                }
-                rage += use_effects[i].rage_boost;
-                rage = std::min(100.0, rage);
-                use_effects.erase(use_effects.begin() + i);
-                if (use_effects[i].triggers_gcd)
-                {
-                    global_cooldown = 1.5;
-                }
+                continue;
             }
-            else
+            if (!performance_mode)
             {
-                ++i;
+                aura_uptime[hit_gains[i].id] += hit_gains[i].end_time - hit_gains[i].start_time;
             }
+            if (debug)
+            {
+                status.emplace_back(names[hit_gains[i].id] + " fades.");
+            }
+            hit_gains.erase(hit_gains.begin() + i);
+            return;
         }
-        i = 0;
-        while (i < over_time_buffs.size())
+    }
+
+    template <bool debug>
+    void tick_over_time_buff(const Buff_event& event, double& rage, std::vector<std::string>& status)
+    {
+        for (size_t i = 0; i < over_time_buffs.size(); i++)
         {
-            if ((int(current_time) - over_time_buffs[i].init_time) / over_time_buffs[i].interval >=
-                over_time_buffs[i].current_ticks)
+            if (over_time_buffs[i].key != event.key)
+            {
+                continue;
+            }
+            if (over_time_buffs[i].current_ticks < over_time_buffs[i].total_ticks)
             {
                 rage += over_time_buffs[i].rage_gain;
                 (*simulation_special_stats) += over_time_buffs[i].special_stats;
@@ -255,115 +361,77 @@ public:
                 {
                     if (over_time_buffs[i].rage_gain > 0)
                     {
-                        status.emplace_back("Over time effect: " + over_time_buffs[i].id +
+                        status.emplace_back("Over time effect: " + names[over_time_buffs[i].id] +
                                             " tick. Current rage: " + std::to_string(int(rage)));
                     }
                     else if (over_time_buffs[i].damage > 0)
                     {
-                        status.emplace_back("Over time effect: " + over_time_buffs[i].id +
+                        status.emplace_back("Over time effect: " + names[over_time_buffs[i].id] +
                                             " tick. Damage: " + std::to_string(int(over_time_buffs[i].damage)));
                     }
                     else
                     {
-                        status.emplace_back("Over time effect: " + over_time_buffs[i].id + " tick.");
+                        status.emplace_back("Over time effect: " + names[over_time_buffs[i].id] + " tick.");
                     }
                 }
             }
-            if (over_time_buffs[i].current_ticks == over_time_buffs[i].total_ticks)
+            if (over_time_buffs[i].current_ticks >= over_time_buffs[i].total_ticks)
             {
                 if (debug)
                 {
-                    status.emplace_back("Over time effect: " + over_time_buffs[i].id + " fades.");
+                    status.emplace_back("Over time effect: " + names[over_time_buffs[i].id] + " fades.");
                 }
                 over_time_buffs.erase(over_time_buffs.begin() + i);
-                if (over_time_buffs.empty())
-                {
-                    min_interval = 10;
-                }
-                else
-                {
-                    for (const auto& over_time_buff : over_time_buffs)
-                    {
-                        min_interval = std::min(over_time_buff.interval, min_interval);
-                    }
-                }
             }
             else
             {
-                i++;
+                schedule(over_time_buffs[i].next_tick(), Buff_event::Type::over_time_tick, event.key);
             }
+            return;
         }
     }
 
-    void add(const std::string& name, const Special_stats& special_stats, double duration_left)
+    template <bool debug>
+    void activate_use_effects(double time_left, double& rage, double& global_cooldown_ready,
+                              std::vector<std::string>& status)
     {
-        for (auto& gain : stat_gains)
-        {
-            if (name == gain.id)
-            {
-                gain.duration_left = duration_left;
-                return;
-            }
-        }
-        (*simulation_special_stats) += special_stats;
-        if (special_stats.hit > 0.0 || special_stats.critical_strike > 0.0)
-        {
-            need_to_recompute_hittables = true;
-        }
-        stat_gains.emplace_back(name, special_stats, duration_left);
-    }
-
-    void add_hit_effect(const std::string& name, const Hit_effect& hit_effect, double duration_left)
-    {
-        (*hit_effects_mh).emplace_back(hit_effect);
-        (*hit_effects_oh).emplace_back(hit_effect);
-        hit_gains.emplace_back(name, duration_left);
-    }
-
-    void add_over_time_effect(const Over_time_effect& over_time_effect, int init_time)
-    {
-        if (over_time_effect.name == "Deep_wounds")
+        size_t i = 0;
+        while (i < pending_use_effects.size())
         {
-            for (auto& over_time_buff : over_time_buffs)
+            const Use_effect& use_effect = (*use_effects)[pending_use_effects[i]];
+            if (time_left - use_effect.duration - 1.5 < 0.0 && current_time >= global_cooldown_ready &&
+                rage >= -use_effect.rage_boost)
             {
-                if (over_time_buff.id == "Deep_wounds")
+                if (debug)
                 {
-                    over_time_buff.damage = std::max(over_time_effect.damage, over_time_buff.damage);
-                    over_time_buff.total_ticks =
-                        (over_time_effect.duration + init_time - over_time_buff.init_time) / over_time_buff.interval;
-                    return;
+                    status.emplace_back("Activating: " + names[use_effect.id]);
                 }
+                if (!use_effect.hit_effects.empty())
+                {
+                    add_hit_effect(use_effect.id, use_effect.hit_effects[0], use_effect.hit_effects[0].duration);
+                }
+                else if (!use_effect.over_time_effects.empty())
+                {
+                    add_over_time_effect(use_effect.over_time_effects[0], int(current_time + 1));
+                }
+                else
+                {
+                    add(use_effect.id, use_effect.get_special_stat_equivalent(*simulation_special_stats),
+                        use_effect.duration);
+                }
+                rage += use_effect.rage_boost;
+                rage = std::min(100.0, rage);
+                if (use_effect.triggers_gcd)
+                {
+                    global_cooldown_ready = current_time + 1.5;
+                }
+                pending_use_effects.erase(pending_use_effects.begin() + i);
             }
-        }
-        min_interval = std::min(over_time_effect.interval, min_interval);
-        over_time_buffs.emplace_back(over_time_effect.name, over_time_effect.special_stats, init_time,
-                                     over_time_effect.rage_gain, over_time_effect.damage, over_time_effect.interval,
-                                     over_time_effect.duration);
-    }
-
-    void increment_proc(const std::string& name)
-    {
-        for (auto& proc : procs)
-        {
-            if (name == proc.id)
-            {
-                proc.counter++;
-                return;
-            }
-        }
-        procs.emplace_back(name, 1);
-    }
-
-    bool can_do_overpower()
-    {
-        for (auto& gain : stat_gains)
-        {
-            if ("overpower_aura" == gain.id)
+            else
             {
-                return true;
+                ++i;
             }
         }
-        return false;
     }
 
     bool need_to_recompute_hittables{false};
@@ -372,15 +440,18 @@ public:
     std::vector<Combat_buff> stat_gains;
     std::vector<Hit_buff> hit_gains;
     std::vector<Over_time_buff> over_time_buffs;
-    std::vector<Hit_effect>* hit_effects_mh;
-    std::vector<Hit_effect>* hit_effects_oh;
-    std::vector<Use_effect> use_effects;
-    double next_event = 10;
+    const std::vector<Use_effect>* use_effects;
+    std::vector<size_t> pending_use_effects;
+    std::vector<Buff_event> events;
+    int next_key{};
+    double current_time{};
+    double use_effects_window{};
     double rage_before_execute{};
     double rage_spent_executing{};
-    int min_interval = 10;
-    Aura_uptime aura_uptime;
-    std::vector<Proc> procs;
+    std::vector<std::string> names;
+    std::vector<double> aura_uptime;
+    std::vector<int> procs;
+    std::vector<bool> active;
     double deep_wounds_damage{};
     std::vector<double> deep_wounds_timestamps{};
 };
@@ -4,6 +4,8 @@
 #include "Buff_manager.hpp"
 #include "Character.hpp"
 #include "Helper_functions.hpp"
+#include "Hit_table.hpp"
+#include "Random_engine.hpp"
 #include "Statistics.hpp"
 #include "damage_sources.hpp"
 #include "sim_input.hpp"
@@ -14,8 +16,11 @@
 #include <array>
 #include <cassert>
 #include <cmath>
+#include <functional>
 #include <iomanip>
 #include <map>
+#include <thread>
+#include <utility>
 #include <vector>
 
 struct Combat_simulator_config
@@ -59,6 +64,7 @@ struct Combat_simulator_config
     bool performance_mode{false};
     bool use_seed{false};
     int seed{};
+    int n_threads{1};
 
     struct combat_t
     {
@@ -129,10 +135,42 @@ public:
         config = new_config;
         if (config.use_seed)
         {
-            srand(config.seed);
+            fight_index_ = 0;
         }
     }
 
+    // Browser builds without pthreads can not start threads, everything then runs on the calling thread
+    static constexpr bool threads_supported()
+    {
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+        return false;
+#else
+        return true;
+#endif
+    }
+
+    // The next simulated fight uses the random stream of this fight index, which makes single fights reproducible
+    void set_fight_index(uint64_t fight_index) { fight_index_ = fight_index; }
+
+    constexpr uint64_t get_fight_index() const { return fight_index_; }
+
+    // Records the DPS of every fight in the following simulate calls, see get_fight_dps
+    void set_record_fight_dps(bool record_fight_dps) { record_fight_dps_ = record_fight_dps; }
+
+    // DPS of each fight of the last simulate call, in fight index order. Fights with the same fight index share their
+    // random stream, so two characters simulated from the same fight index can be compared fight by fight.
+    const std::vector<double>& get_fight_dps() const { return fight_dps_; }
+
+    static constexpr int progress_interval = 16;
+
+    // Called with the DPS statistics so far after every progress_interval fights. Returning false stops the
+    // simulate call early, its results then cover the fights simulated until then. The callback may run on a worker
+    // thread of a multi-threaded simulation, but never on two threads at once.
+    void set_progress_callback(std::function<bool(const Statistics::Running_statistics&)> progress_callback)
+    {
+        progress_callback_ = std::move(progress_callback);
+    }
+
     enum class Hit_result
     {
         miss,
@@ -189,28 +227,45 @@ public:
         Hit_result hit_result;
     };
 
+    template <bool debug>
     void manage_flurry(Hit_result hit_result, Special_stats& special_stats, int& flurry_charges,
                        bool is_ability = false);
 
+    template <bool debug>
     void swing_weapon(Weapon_sim& weapon, Weapon_sim& main_hand_weapon, Special_stats& special_stats, double& rage,
                       Damage_sources& damage_sources, int& flurry_charges, double attack_power_bonus = 0,
                       bool is_extra_attack = false);
 
+    template <bool debug>
     void hit_effects(Weapon_sim& weapon, Weapon_sim& main_hand_weapon, Special_stats& special_stats, double& rage,
                      Damage_sources& damage_sources, int& flurry_charges, bool is_extra_attack = false);
 
+    template <bool debug>
+    void roll_hit_effect(const Hit_effect& hit_effect, Weapon_sim& weapon, Weapon_sim& main_hand_weapon,
+                         Special_stats& special_stats, double& rage, Damage_sources& damage_sources,
+                         int& flurry_charges, bool is_extra_attack);
+
+    // Resolves the names of all buffs, procs and over time effects that can occur in the simulation to buff ids
+    void register_buff_ids(std::vector<Weapon_sim>& weapons, std::vector<Use_effect>& use_effects,
+                           std::vector<Over_time_effect>& over_time_effects);
+
+    template <bool debug>
     void overpower(Weapon_sim& main_hand_weapon, Special_stats& special_stats, double& rage,
                    Damage_sources& damage_sources, int& flurry_charges);
 
+    template <bool debug>
     void bloodthirst(Weapon_sim& main_hand_weapon, Special_stats& special_stats, double& rage,
                      Damage_sources& damage_sources, int& flurry_charges);
 
+    template <bool debug>
     void whirlwind(Weapon_sim& main_hand_weapon, Special_stats& special_stats, double& rage,
                    Damage_sources& damage_sources, int& flurry_charges);
 
+    template <bool debug>
     void execute(Weapon_sim& main_hand_weapon, Special_stats& special_stats, double& rage,
                  Damage_sources& damage_sources, int& flurry_charges, double execute_cost);
 
+    template <bool debug>
     void hamstring(Weapon_sim& main_hand_weapon, Special_stats& special_stats, double& rage,
                    Damage_sources& damage_sources, int& flurry_charges);
 
@@ -222,32 +277,68 @@ public:
     void simulate(const Character& character, int init_iteration = 0, bool compute_time_lape = false,
                   bool compute_histogram = false);
 
-    static double get_uniform_random(double r_max) { return rand() * r_max / RAND_MAX; }
+    // Runs the fights on this thread. Instantiated with and without the combat log, so performance runs carry no
+    // logging code at all.
+    template <bool debug>
+    void simulate_fights(const Character& character, int init_iteration, bool compute_time_lapse,
+                         bool compute_histogram);
+
+    // Splits the batches over config.n_threads worker simulators and merges their results into this one
+    void simulate_parallel(const Character& character, bool compute_time_lapse, bool compute_histogram);
 
-    static double get_uniform_random(double r_min, double r_max) { return r_min + rand() * (r_max - r_min) / RAND_MAX; }
+    // Every fight draws from one random stream per purpose. When a change to the character alters e.g. the number of
+    // procs, the hit table rolls of the same fight stay the same, which keeps paired simulations of two characters
+    // in step for longer.
+    enum Random_stream
+    {
+        white_main_hand_stream,
+        white_off_hand_stream,
+        yellow_stream,
+        effect_stream,
+        n_random_streams
+    };
 
+    double get_uniform_random(Random_stream stream, double r_max) { return random_engines_[stream].uniform() * r_max; }
+
+    // Raw roll for Hit_table::roll
+    uint64_t get_hit_roll(Random_stream stream) { return random_engines_[stream].uniform_integer(); }
+
+    double get_uniform_random(Random_stream stream, double r_min, double r_max)
+    {
+        return r_min + random_engines_[stream].uniform() * (r_max - r_min);
+    }
+
+    template <bool debug>
     Combat_simulator::Hit_outcome generate_hit(const Weapon_sim& weapon, double damage, Hit_type hit_type,
                                                Socket weapon_hand, const Special_stats& special_stats,
                                                bool boss_target = true, bool is_overpower = false);
 
+    template <bool debug>
     Combat_simulator::Hit_outcome generate_hit_oh(double damage);
 
+    template <bool debug>
     Combat_simulator::Hit_outcome generate_hit_mh(double damage, Hit_type hit_type, bool is_overpower = false);
 
     void compute_hit_table(int level_difference, int weapon_skill, Special_stats special_stats, Socket weapon_hand);
 
-    const std::vector<double>& get_hit_probabilities_white_mh() const;
+    // Same as compute_hit_table, but reuses the tables of an earlier call with the same crit, hit, weapon skill, level
+    // difference and hand. Procs and stance swaps mostly toggle between a few such combinations.
+    void update_hit_table(int level_difference, int weapon_skill, const Special_stats& special_stats,
+                          Socket weapon_hand);
+
+    const std::array<double, Hit_table::n_thresholds>& get_hit_probabilities_white_mh() const;
 
-    const std::vector<double>& get_hit_probabilities_white_oh() const;
+    const std::array<double, Hit_table::n_thresholds>& get_hit_probabilities_white_oh() const;
 
-    const std::vector<double>& get_hit_probabilities_white_2h() const;
+    const std::array<double, Hit_table::n_thresholds>& get_hit_probabilities_white_2h() const;
 
-    const std::vector<double>& get_hit_probabilities_yellow() const;
+    const std::array<double, Hit_table::n_thresholds>& get_hit_probabilities_yellow() const;
 
     double get_glancing_penalty_mh() const;
 
     double get_glancing_penalty_oh() const;
 
+    template <bool debug>
     void cout_damage_parse(Combat_simulator::Hit_type hit_type, Socket weapon_hand,
                            Combat_simulator::Hit_outcome hit_outcome);
 
@@ -265,11 +356,15 @@ public:
 
     std::string get_debug_topic() const;
 
-    constexpr double get_dps_mean() const { return dps_mean_; }
+    constexpr double get_dps_mean() const { return dps_statistics_.get_mean(); }
 
-    constexpr double get_dps_variance() const { return dps_variance_; }
+    constexpr double get_dps_variance() const { return dps_statistics_.get_variance(); }
 
-    constexpr int get_n_simulations() const { return config.n_batches; }
+    // DPS statistics of all fights since the last simulate call that did not continue earlier fights
+    const Statistics::Running_statistics& get_dps_statistics() const { return dps_statistics_; }
+
+    // Fights run by the last simulate call, fewer than config.n_batches when the progress callback stopped it
+    constexpr int get_n_simulations() const { return n_simulated_; }
 
     constexpr int get_rage_lost_stance() const { return rage_lost_stance_swap_; }
 
@@ -277,15 +372,10 @@ public:
 
     constexpr int get_rage_lost_capped() const { return rage_lost_capped_; }
 
-    constexpr int get_avg_rage_spent_executing() const { return avg_rage_spent_executing_; }
-
-    std::vector<double>& get_hist_x() { return hist_x; }
+    constexpr int get_avg_rage_spent_executing() const { return avg_rage_spent_executing_.get_mean(); }
 
-    std::vector<int>& get_hist_y() { return hist_y; }
-
-    void init_histogram();
-
-    void prune_histogram();
+    // DPS distribution of the last simulate call that computed a histogram
+    const Statistics::Quantile_sketch& get_dps_sketch() const { return dps_sketch_; }
 
     void normalize_timelapse();
 
@@ -295,10 +385,10 @@ public:
 
     void print_statement(double t) { debug_topic_ += std::to_string(t); }
 
-    template <typename... Args>
+    template <bool debug, typename... Args>
     void simulator_cout(Args&&... args)
     {
-        if (config.display_combat_debug)
+        if (debug)
         {
             //            s. Loop idx:" + std::to_string(                    time_keeper_.step_index) +=
             debug_topic_ += "Time: " + std::to_string(time_keeper_.time) + "s. Event: ";
@@ -322,19 +412,31 @@ private:
 
     Over_time_effect anger_management = {"Anger_Management", {}, 1, 0, 3, 600};
 
-    std::vector<double> hit_table_white_mh_;
-    std::vector<double> damage_multipliers_white_mh_;
-    std::vector<double> hit_table_white_oh_;
-    std::vector<double> damage_multipliers_white_oh_;
-    std::vector<double> hit_table_yellow_;
-    std::vector<double> hit_table_overpower_;
-    std::vector<double> damage_multipliers_yellow_;
-    std::vector<double> hit_table_two_hand_;
+    Over_time_effect deep_wounds = {"Deep_wounds", {}, 0, 0, 3, 12};
+
+    Hit_table hit_table_white_mh_{};
+    Hit_table hit_table_white_oh_{};
+    Hit_table hit_table_yellow_{};
+    Hit_table hit_table_overpower_{};
+    Hit_table hit_table_two_hand_{};
+
+    // Hit tables of one hand for the stats they depend on. The tables also depend on the config, so the cache is
+    // emptied at the start of every simulation.
+    struct Hit_table_cache_entry
+    {
+        double critical_strike;
+        double hit;
+        int weapon_skill;
+        int level_difference;
+        Socket weapon_hand;
+        // White, yellow and overpower tables for the main hand, white and two hand tables for the off hand
+        std::array<Hit_table, 3> hit_tables;
+    };
+
+    std::vector<Hit_table_cache_entry> hit_table_cache_;
     Damage_sources damage_distribution_{};
-    double dps_mean_;
-    double dps_variance_;
-    std::vector<double> hist_x{};
-    std::vector<int> hist_y{};
+    Statistics::Running_statistics dps_statistics_{};
+    Statistics::Quantile_sketch dps_sketch_{};
     double armor_reduction_factor_{};
     double target_armor_{};
     double armor_reduction_factor_add{};
@@ -342,9 +444,9 @@ private:
     Time_keeper time_keeper_{};
     Buff_manager buff_manager_{};
     Ability_queue_manager ability_queue_manager{};
-    double flurry_uptime_mh_{};
-    double flurry_uptime_oh_{};
-    double heroic_strike_uptime_{};
+    Statistics::Running_statistics flurry_uptime_mh_{};
+    Statistics::Running_statistics flurry_uptime_oh_{};
+    Statistics::Running_statistics heroic_strike_uptime_{};
     std::string debug_topic_{};
     int adds_in_melee_range{};
     double remove_adds_timer{};
@@ -352,11 +454,19 @@ private:
     double rage_lost_execute_batch_{};
     double rage_lost_stance_swap_{};
     double rage_lost_capped_{};
-    double avg_rage_spent_executing_{};
+    Statistics::Running_statistics avg_rage_spent_executing_{};
     double p_unbridled_wrath_{};
     bool dpr_heroic_strike_queued_{false};
     bool dpr_cleave_queued_{false};
     std::vector<std::vector<double>> damage_time_lapse{};
+    std::array<Random_engine, n_random_streams> random_engines_{};
+    uint64_t fight_index_{};
+    int ramp_offset_{};
+    int ramp_batches_{};
+    int n_simulated_{};
+    bool record_fight_dps_{false};
+    std::vector<double> fight_dps_;
+    std::function<bool(const Statistics::Running_statistics&)> progress_callback_;
     std::map<Damage_source, int> source_map{
         {Damage_source::white_mh, 0},         {Damage_source::white_oh, 1},      {Damage_source::bloodthirst, 2},
         {Damage_source::execute, 3},          {Damage_source::heroic_strike, 4}, {Damage_source::cleave, 5},
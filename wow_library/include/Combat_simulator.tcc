@@ -80,6 +80,10 @@ void Combat_simulator_config::get_combat_simulator_config(const T& input)
     {
         combat.deep_wounds = true;
     }
+    if (find_string(input.options, "multi_threaded"))
+    {
+        n_threads = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+    }
     if (find_string(input.options, "heroic_strike_aq"))
     {
         combat.heroic_strike_damage = 157;
@@ -3,6 +3,7 @@
 
 #include "Character.hpp"
 
+#include <algorithm>
 #include <iomanip>
 #include <sstream>
 #include <string>
@@ -17,6 +18,43 @@ constexpr double skill_w_soft = 70.0 / 5;
 constexpr double skill_w_hard = 20.0 / 5;
 constexpr double ap_per_coh = 20 / 6.2;
 
+// AP equivalent of a weapon over plain numbers, so that it can score struct-of-arrays blocks of gear sets. The branches
+// are plain selects, relevant_skill is the weapon skill as a double.
+inline double get_ap_equivalent(double critical_strike, double hit, double chance_for_extra_hit, double bonus_damage,
+                                double relevant_skill, double swing_speed, double weapon_damage)
+{
+    double skill_diff = 315 - relevant_skill;
+    double crit_chance = critical_strike - 15 * 0.2 - 1.8; // 1.8 flat aura modifier
+
+    // Miss chance
+    double base_miss_chance = skill_diff > 10 ? 5.0 + skill_diff * 0.2 : skill_diff > 0 ? 5.0 + skill_diff * 0.1 : 5.0;
+    double hit_penalty = skill_diff > 10 ? 1.0 : 0.0;
+    double miss_chance_yellow = base_miss_chance + hit_penalty;
+    double dw_miss_chance = (base_miss_chance * 0.8 + 20.0);
+    double miss_chance = dw_miss_chance - std::max(hit - hit_penalty, 0.0);
+
+    // Dodge chance
+    double dodge_chance = std::max(5 + skill_diff * 0.1, 5.0);
+    double crit_cap = 100 - (miss_chance + dodge_chance + 40);
+
+    double ap_equiv = crit_chance > crit_cap ? (crit_chance - crit_cap) * crit_w_cap + crit_cap * crit_w :
+                                               crit_chance * crit_w;
+    ap_equiv += hit > miss_chance_yellow ? (hit - miss_chance_yellow) * hit_w_cap + miss_chance_yellow * hit_w :
+                                           hit * hit_w;
+
+    // ish good estimation
+    ap_equiv += chance_for_extra_hit / 2 * hit_w;
+
+    double extra_skill = relevant_skill - 300;
+    ap_equiv += extra_skill > 0 ? std::min(5.0, extra_skill) * skill_w : 0.0;
+    ap_equiv += extra_skill > 5 ? std::min(5.0, extra_skill - 5) * skill_w_soft : 0.0;
+    ap_equiv += extra_skill > 10 ? extra_skill - 10 * skill_w_hard : 0.0;
+
+    ap_equiv += (weapon_damage + bonus_damage) / swing_speed * 14;
+
+    return ap_equiv;
+}
+
 double get_ap_equivalent(const Special_stats& special_stats, int relevant_skill, double swing_speed,
                          double weapon_damage);
 
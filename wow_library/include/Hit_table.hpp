@@ -0,0 +1,61 @@
+#ifndef WOW_SIMULATOR_HIT_TABLE_HPP
+#define WOW_SIMULATOR_HIT_TABLE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+// Attack table of one kind of attack. The thresholds are the cumulative chances, in percent, of miss, dodge,
+// glancing and crit. A roll above all of them is a regular hit. The outcome of a roll is the number of thresholds
+// below it, which needs neither a search nor branches. Rolls are the raw integers of Random_engine::uniform_integer,
+// compared against the thresholds scaled to the same range, so rolling needs no floating point either.
+class Hit_table
+{
+public:
+    static constexpr int n_thresholds = 4;
+
+    // Miss, dodge, glancing, crit and hit, in the order of Combat_simulator::Hit_result
+    static constexpr int n_outcomes = n_thresholds + 1;
+
+    // Rolls are uniform integers in [0, roll_range), which is 2^53
+    static constexpr double roll_range = 9007199254740992.0;
+
+    Hit_table() = default;
+
+    Hit_table(const std::array<double, n_thresholds>& thresholds, const std::array<double, n_outcomes>& multipliers)
+        : thresholds_(thresholds), multipliers_(multipliers)
+    {
+        int64_t previous = -1;
+        for (int i = 0; i < n_thresholds; i++)
+        {
+            // A roll r in [0, 100) lies above threshold t when the integer roll is above t / 100 * roll_range. The
+            // threshold is clamped to the roll range, and a negative chance counts as zero to keep the thresholds in
+            // order.
+            double scaled = std::floor(thresholds[i] / 100.0 * roll_range);
+            scaled = std::min(std::max(scaled, -1.0), roll_range);
+            previous = std::max(previous, static_cast<int64_t>(scaled));
+            integer_thresholds_[i] = previous;
+        }
+    }
+
+    // Outcome of an integer roll, see Combat_simulator::Hit_result
+    int roll(uint64_t random_integer) const
+    {
+        const auto r = static_cast<int64_t>(random_integer);
+        return static_cast<int>(r > integer_thresholds_[0]) + static_cast<int>(r > integer_thresholds_[1]) +
+               static_cast<int>(r > integer_thresholds_[2]) + static_cast<int>(r > integer_thresholds_[3]);
+    }
+
+    double get_multiplier(int outcome) const { return multipliers_[outcome]; }
+
+    // Cumulative chances in percent, as the table was created
+    const std::array<double, n_thresholds>& get_thresholds() const { return thresholds_; }
+
+private:
+    std::array<double, n_thresholds> thresholds_{};
+    std::array<double, n_outcomes> multipliers_{};
+    std::array<int64_t, n_thresholds> integer_thresholds_{};
+};
+
+#endif // WOW_SIMULATOR_HIT_TABLE_HPP
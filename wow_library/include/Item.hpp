@@ -80,6 +80,7 @@ struct Over_time_effect
     double damage;
     int interval;
     double duration;
+    int id{-1}; // Assigned by the simulator, see Buff_manager::get_id
 };
 
 class Hit_effect
@@ -129,6 +130,7 @@ public:
     int n_targets;
     double armor_reduction;
     int max_stacks;
+    int id{-1}; // Assigned by the simulator, see Buff_manager::get_id
 };
 
 class Use_effect
@@ -174,6 +176,7 @@ public:
     bool triggers_gcd{false};
     std::vector<Hit_effect> hit_effects{};
     std::vector<Over_time_effect> over_time_effects{};
+    int id{-1}; // Assigned by the simulator, see Buff_manager::get_id
 };
 
 struct Enchant
@@ -10,6 +10,7 @@
 #include <ctime>
 #include <iostream>
 #include <sstream>
+#include <unordered_map>
 
 class Item_optimizer
 {
@@ -27,6 +28,7 @@ public:
         double mean_dps{};
         double variance{};
         double ap_equivalent{};
+        size_t n_simulations{};
     };
 
     void compute_weapon_combinations();
@@ -47,6 +49,25 @@ public:
 
     Character construct(size_t index);
 
+    // Constructs the characters of the given sets once, so that every optimizer round can reuse them. The cached
+    // characters are sim-ready: they keep the total stats, weapons and use effects, but not the item lists.
+    void cache_characters(const std::vector<Sim_result_t>& sim_results);
+
+    // Drops the cached characters of the sets that are not in sim_results
+    void retain_cached_characters(const std::vector<Sim_result_t>& sim_results);
+
+    const Character& get_cached_character(size_t index) const { return character_cache.at(index); }
+
+    // Computes the AP equivalent of every combination, in index order. Instead of constructing each character, the
+    // stats are summed per slot and only the slots that changed since the previous index are re-added. The optimizer
+    // itself uses find_best_ap_equivalents, this full pass is the reference that the tests check it against.
+    std::vector<double> compute_ap_equivalents();
+
+    // The n_best sets with the highest AP equivalents, in index order. Same estimate as compute_ap_equivalents, but
+    // found with a branch and bound search over the slots, so the cost grows with the number of promising sets rather
+    // than with total_combinations.
+    std::vector<Sim_result_t> find_best_ap_equivalents(size_t n_best, std::string& debug_message);
+
     std::vector<Weapon> remove_weaker_weapons(Weapon_socket weapon_socket, const std::vector<Weapon>& weapon_vec,
                                               const Special_stats& special_stats, std::string& debug_message);
 
@@ -66,6 +87,8 @@ public:
     double get_total_qp_equivalent(const Special_stats& special_stats, const Weapon& wep1, const Weapon& wep2,
                                    const std::vector<Use_effect>& use_effects);
 
+    double get_use_effect_ap(const Use_effect& use_effect, const Special_stats& special_stats) const;
+
     std::vector<Armor> helmets;
     std::vector<Armor> necks;
     std::vector<Armor> shoulders;
@@ -100,6 +123,7 @@ public:
 
 private:
     Armory armory;
+    std::unordered_map<size_t, Character> character_cache;
 };
 
 bool operator<(const Item_optimizer::Sim_result_t& left, const Item_optimizer::Sim_result_t& right);
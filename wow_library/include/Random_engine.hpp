@@ -0,0 +1,72 @@
+#ifndef WOW_SIMULATOR_RANDOM_ENGINE_HPP
+#define WOW_SIMULATOR_RANDOM_ENGINE_HPP
+
+#include <cstdint>
+#include <limits>
+
+// xoshiro256+ by Blackman and Vigna. Every fight is simulated on its own stream, where the stream state is derived
+// from (seed, stream index) with splitmix64. This makes any fight reproducible without replaying the earlier ones,
+// and lets parallel workers produce the exact same fights as a serial run.
+class Xoshiro256_plus
+{
+public:
+    using result_type = uint64_t;
+
+    Xoshiro256_plus() { seed(0, 0); }
+
+    Xoshiro256_plus(uint64_t seed_value, uint64_t stream) { seed(seed_value, stream); }
+
+    static constexpr result_type min() { return 0; }
+
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    void seed(uint64_t seed_value, uint64_t stream)
+    {
+        uint64_t x = seed_value ^ (stream * 0xd1342543de82ef95ULL);
+        for (auto& word : state_)
+        {
+            word = splitmix64(x);
+        }
+    }
+
+    result_type operator()()
+    {
+        const uint64_t result = state_[0] + state_[3];
+        const uint64_t t = state_[1] << 17;
+        state_[2] ^= state_[0];
+        state_[3] ^= state_[1];
+        state_[1] ^= state_[2];
+        state_[0] ^= state_[3];
+        state_[2] ^= t;
+        state_[3] = rotl(state_[3], 45);
+        return result;
+    }
+
+    // Uniform integer in [0, 2^53) from the 53 high bits
+    uint64_t uniform_integer() { return (*this)() >> 11; }
+
+    // Uniform double in [0, 1), uniform_integer scaled down
+    double uniform() { return static_cast<double>(uniform_integer()) * (1.0 / 9007199254740992.0); }
+
+private:
+    static constexpr uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    static uint64_t splitmix64(uint64_t& x)
+    {
+        uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t state_[4];
+};
+
+// The engine used by the simulator. Another engine can be plugged in here if it is default constructible and has:
+// - seed(seed, stream), which starts the stream of a fight
+// - uniform(), a double in [0, 1), for damage rolls and proc chances
+// - uniform_integer(), an integer in [0, 2^53), for the hit table rolls of Combat_simulator::get_hit_roll. The range
+//   has to be exactly Hit_table::roll_range, which the thresholds are scaled to.
+using Random_engine = Xoshiro256_plus;
+
+#endif // WOW_SIMULATOR_RANDOM_ENGINE_HPP
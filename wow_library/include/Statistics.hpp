@@ -2,6 +2,7 @@
 #define WOW_SIMULATOR_STATISTICS_HPP
 
 #include <cmath>
+#include <string>
 #include <vector>
 
 namespace Statistics
@@ -16,20 +17,135 @@ double sample_deviation(double standard_dev, int n_samples);
 
 double add_standard_deviations(double std1, double std2);
 
-constexpr double update_mean(double mean, int tot_samples, double new_sample)
+// Mean and variance of a stream of samples, updated with Welford's method so that millions of samples do not lose
+// precision. Accumulators of disjoint samples merge into the accumulator of all samples (Chan et al. "Updating
+// formulae and a pairwise algorithm for computing sample variances"), which combines the partial results of threads
+// or separate runs.
+class Running_statistics
 {
-    return (mean * (tot_samples - 1) + new_sample) / tot_samples;
-}
+public:
+    Running_statistics() = default;
 
-constexpr double update_variance(double variance, double mean, int tot_samples, double new_sample)
+    // Continues from count earlier samples with the given mean and population variance
+    constexpr Running_statistics(size_t count, double mean, double variance)
+        : count_{count}, mean_{mean}, sum_squared_deviations_{variance * static_cast<double>(count)}
+    {
+    }
+
+    void push(double sample)
+    {
+        count_++;
+        double delta = sample - mean_;
+        mean_ += delta / static_cast<double>(count_);
+        sum_squared_deviations_ += delta * (sample - mean_);
+    }
+
+    void merge(const Running_statistics& other)
+    {
+        if (other.count_ == 0)
+        {
+            return;
+        }
+        if (count_ == 0)
+        {
+            *this = other;
+            return;
+        }
+        double count = static_cast<double>(count_);
+        double other_count = static_cast<double>(other.count_);
+        double total = count + other_count;
+        double delta = other.mean_ - mean_;
+        mean_ += delta * other_count / total;
+        sum_squared_deviations_ += other.sum_squared_deviations_ + delta * delta * count * other_count / total;
+        count_ += other.count_;
+    }
+
+    // Text form that restores the accumulator exactly
+    std::string serialize() const;
+
+    // Restores an accumulator from serialize. Returns false and keeps the current state if the text is malformed.
+    bool deserialize(const std::string& serialized);
+
+    constexpr size_t get_count() const { return count_; }
+
+    constexpr double get_mean() const { return mean_; }
+
+    // Population variance of the samples
+    constexpr double get_variance() const
+    {
+        return (count_ > 0) ? sum_squared_deviations_ / static_cast<double>(count_) : 0.0;
+    }
+
+    double get_standard_error() const
+    {
+        return (count_ > 0) ? sample_deviation(std::sqrt(get_variance()), static_cast<int>(count_)) : 0.0;
+    }
+
+private:
+    size_t count_{};
+    double mean_{};
+    double sum_squared_deviations_{};
+};
+
+// Quantile sketch of non-negative samples, see Masson et al. "DDSketch: A fast and fully-mergeable quantile sketch
+// with relative-error guarantees". The samples are counted in buckets whose width grows with the value, so every
+// quantile is within relative_accuracy of the exact sample quantile. Bucket counts add up, which makes merging the
+// sketches of threads or separate runs exact. At most max_buckets buckets are kept; beyond that the lowest buckets
+// are collapsed, which only makes the lowest quantiles less accurate.
+class Quantile_sketch
 {
-    double new_mean = (mean * (tot_samples - 1) + new_sample) / tot_samples;
-    return ((tot_samples - 1) * variance + (new_sample - new_mean) * (new_sample - mean)) / tot_samples;
-}
+public:
+    explicit Quantile_sketch(double relative_accuracy = 0.001, size_t max_buckets = 2048);
+
+    void push(double sample);
+
+    // Both sketches need the same relative accuracy
+    void merge(const Quantile_sketch& other);
+
+    // Text form that restores the sketch exactly
+    std::string serialize() const;
+
+    // Restores a sketch from serialize. Returns false and keeps the current state if the text is malformed.
+    bool deserialize(const std::string& serialized);
+
+    size_t get_count() const { return count_; }
+
+    // Approximates the sample quantile, e.g. 0.95 for the 95th percentile. Returns 0 for an empty sketch.
+    double get_quantile(double quantile) const;
+
+    // Counts the samples in bins of bin_width, bin i covers [bin_x[i], bin_x[i] + bin_width). The bins span the
+    // lowest to the highest sample.
+    void get_histogram(double bin_width, std::vector<double>& bin_x, std::vector<int>& bin_count) const;
+
+private:
+    int get_bucket_index(double value) const
+    {
+        return static_cast<int>(std::ceil(std::log(value) * inverse_log_gamma_));
+    }
+
+    double get_bucket_value(int index) const { return 2.0 * std::pow(gamma_, index) / (gamma_ + 1.0); }
+
+    void add_to_bucket(int index, size_t count);
+
+    double relative_accuracy_;
+    double gamma_;
+    double inverse_log_gamma_;
+    size_t max_buckets_;
+    size_t count_{};
+    size_t zero_count_{};
+    // bucket_counts_[i] counts the samples in (gamma^(i + bucket_offset_ - 1), gamma^(i + bucket_offset_)]
+    int bucket_offset_{};
+    std::vector<size_t> bucket_counts_{};
+};
 
 double normalCDF(double value);
 
-double find_cdf_quantile(double target_quantile, double precision);
+// Quantile of the standard normal distribution, the inverse of normalCDF
+double inverse_normal_cdf(double probability);
+
+// Quantile of Student's t distribution. Confidence intervals from few samples should use it instead of
+// inverse_normal_cdf, since the sample variance is an estimate as well.
+double student_t_quantile(double probability, double degrees_of_freedom);
 } // namespace Statistics
 
 #endif // WOW_SIMULATOR_STATISTICS_HPP
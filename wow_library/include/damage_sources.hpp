@@ -32,7 +32,7 @@ struct Damage_instance
 
 struct Damage_sources
 {
-    Damage_sources();
+    Damage_sources() = default;
 
     ~Damage_sources() = default;
 
@@ -54,6 +54,9 @@ struct Damage_sources
 
     void add_damage(Damage_source source, double damage, double time_stamp, bool increment_counter = true);
 
+    // Zeroes the sums and counts but keeps the capacity of damage_instances, so it can be reused for the next fight
+    void reset(bool record_instances);
+
     double white_mh_damage{};
     double white_oh_damage{};
     double overpower_damage{};
@@ -79,6 +82,7 @@ struct Damage_sources
     long int item_hit_effects_count{};
 
     std::vector<Damage_instance> damage_instances;
+    bool record_damage_instances{true};
 };
 
 #endif // WOW_SIMULATOR_DAMAGE_SOURCES_HPP
@@ -5,6 +5,11 @@
 #include "sim_output.hpp"
 #include "sim_output_mult.hpp"
 #include "sim_input_mult.hpp"
+#include "sim_progress.hpp"
+
+#include <atomic>
+#include <functional>
+#include <utility>
 
 class Sim_interface
 {
@@ -12,6 +17,31 @@ public:
     Sim_output simulate(const Sim_input &input);
 
     Sim_output_mult simulate_mult(const Sim_input_mult &input);
+
+    // Called between chunks of fights with the progress so far. Returning false ends the DPS simulation of simulate,
+    // or the optimizer rounds of simulate_mult, with the fights simulated until then. The callback may run on a worker
+    // thread of a multi-threaded run, but never on two threads at once.
+    void set_progress_callback(std::function<bool(const Sim_progress &)> progress_callback)
+    {
+        progress_callback_ = std::move(progress_callback);
+    }
+
+    // Stops the running simulation after the current chunk of fights and skips the remaining parts of the run, the
+    // output then holds what was simulated until then. Can be called from any thread. The request is cleared when the
+    // simulation returns, so a cancel that comes in just before a simulation starts stops that simulation.
+    void cancel() { cancelled_ = true; }
+
+    bool is_cancelled() const { return cancelled_; }
+
+private:
+    // False once the run should stop, either from cancel or from the progress callback
+    bool report_progress(const Sim_progress &progress)
+    {
+        return !cancelled_ && (!progress_callback_ || progress_callback_(progress));
+    }
+
+    std::function<bool(const Sim_progress &)> progress_callback_;
+    std::atomic<bool> cancelled_{false};
 };
 
 #endif // INTERFACE_HPP
@@ -0,0 +1,28 @@
+#ifndef SIM_PROGRESS_HPP
+#define SIM_PROGRESS_HPP
+
+#include <cstddef>
+
+// Progress of a running simulation, see Sim_interface::set_progress_callback
+struct Sim_progress
+{
+    // Fights simulated so far, summed over the item sets for simulate_mult
+    size_t n_simulations{};
+
+    // Running DPS mean and its error margin, of the leading item set for simulate_mult
+    double dps_mean{};
+    double dps_error_margin{};
+
+    // Item sets still in the running, always 1 for simulate
+    size_t n_keepers{};
+
+    // Seconds since the start of the run and estimated seconds left. The optimizer can not tell how many rounds it
+    // needs, its estimate is the time left of max_optimize_time.
+    double elapsed_time{};
+    double remaining_time{};
+
+    // Between 0 and 1
+    double fraction_done{};
+};
+
+#endif // SIM_PROGRESS_HPP
@@ -1,60 +1,50 @@
 #ifndef WOW_SIMULATOR_TIME_KEEPER_HPP
 #define WOW_SIMULATOR_TIME_KEEPER_HPP
 
+#include <algorithm>
+
+// Keeps track of the simulation time and of when the abilities come off cooldown. All timestamps are absolute, so
+// nothing needs to be counted down while time advances.
 class Time_keeper
 {
 public:
     Time_keeper() = default;
 
-    void increment(double dt)
-    {
-        blood_thirst_cd -= dt;
-        overpower_cd -= dt;
-        whirlwind_cd -= dt;
-        global_cd -= dt;
-        time += dt;
-    }
-
     void reset()
     {
-        blood_thirst_cd = -1e-10;
-        overpower_cd = -1e-10;
-        whirlwind_cd = -1e-10;
-        global_cd = -1e-10;
+        blood_thirst_ready = 0.0;
+        overpower_ready = 0.0;
+        whirlwind_ready = 0.0;
+        global_ready = 0.0;
         time = 0.0;
     }
 
-    constexpr double get_dynamic_time_step(double mh_dt, double oh_dt, double buff_dt, double sim_dt)
+    constexpr double blood_thirst_cd() const { return blood_thirst_ready - time; }
+
+    constexpr double overpower_cd() const { return overpower_ready - time; }
+
+    constexpr double whirlwind_cd() const { return whirlwind_ready - time; }
+
+    constexpr double global_cd() const { return global_ready - time; }
+
+    // Earliest cooldown that expires after the current time
+    double next_cooldown_event() const
     {
-        double dt = 100.0;
-        if (overpower_cd > 0.0)
-        {
-            dt = std::min(overpower_cd, dt);
-        }
-        if (blood_thirst_cd > 0.0)
-        {
-            dt = std::min(blood_thirst_cd, dt);
-        }
-        if (whirlwind_cd > 0.0)
-        {
-            dt = std::min(whirlwind_cd, dt);
-        }
-        if (global_cd > 0.0)
+        double next = 1e10;
+        for (double ready : {blood_thirst_ready, overpower_ready, whirlwind_ready, global_ready})
         {
-            dt = std::min(global_cd, dt);
+            if (ready > time)
+            {
+                next = std::min(next, ready);
+            }
         }
-        dt = std::min(mh_dt, dt);
-        dt = std::min(oh_dt, dt);
-        dt = std::min(buff_dt, dt);
-        dt = std::min(sim_dt, dt);
-        dt += 1e-5;
-        return dt;
+        return next;
     }
 
-    double blood_thirst_cd;
-    double overpower_cd;
-    double whirlwind_cd;
-    double global_cd;
+    double blood_thirst_ready;
+    double overpower_ready;
+    double whirlwind_ready;
+    double global_ready;
     double time;
 };
 
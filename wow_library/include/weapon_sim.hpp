@@ -9,11 +9,7 @@ public:
     Weapon_sim(double swing_speed, double min_damage, double max_damage, Socket socket, Weapon_type skill_type,
                Weapon_socket weapon_socket, std::vector<Hit_effect> hit_effects);
 
-    constexpr bool time_for_swing(double dt)
-    {
-        internal_swing_timer -= dt;
-        return internal_swing_timer < 0.0;
-    }
+    constexpr bool time_for_swing(double time) const { return time >= next_swing; }
 
     constexpr double swing(double attack_power) const
     {
@@ -38,7 +34,7 @@ public:
 
     double swing_speed;
     double normalized_swing_speed;
-    double internal_swing_timer;
+    double next_swing;
     double min_damage;
     double max_damage;
     double average_damage;
@@ -46,6 +42,8 @@ public:
     Weapon_type weapon_type;
     std::vector<Hit_effect> hit_effects;
     std::string socket_name;
+    // Id of the buff that a stat boost hit effect gives when it procs on this weapon, indexed by the hit effect id
+    std::vector<int> proc_buff_ids;
 };
 
 #endif //WOW_SIMULATOR_WEAPON_SIM_HPP
@@ -0,0 +1,129 @@
+#include "Best_arm_identification.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+Best_arm_identification::Best_arm_identification(size_t n_arms, double confidence, size_t min_kept_arms,
+                                                 size_t first_block_size, double block_growth, size_t n_blocks)
+    : confidence_{confidence}, min_kept_arms_{min_kept_arms}, samples_(n_arms), statistics_(n_arms), arms_(n_arms)
+{
+    block_starts_.reserve(n_blocks + 1);
+    block_starts_.push_back(0);
+    size_t block_size = first_block_size;
+    for (size_t block = 0; block < n_blocks; block++)
+    {
+        block_starts_.push_back(block_starts_.back() + block_size);
+        block_size = static_cast<size_t>(static_cast<double>(block_size) * block_growth);
+    }
+    std::iota(arms_.begin(), arms_.end(), size_t{0});
+    sampled_arms_ = arms_;
+    for (auto& samples : samples_)
+    {
+        samples.reserve(get_target_samples());
+    }
+}
+
+size_t Best_arm_identification::get_block(size_t n_samples) const
+{
+    return static_cast<size_t>(std::lower_bound(block_starts_.begin(), block_starts_.end(), n_samples) -
+                               block_starts_.begin());
+}
+
+size_t Best_arm_identification::get_total_samples() const
+{
+    size_t total_samples = 0;
+    for (const auto& statistics : statistics_)
+    {
+        total_samples += statistics.get_count();
+    }
+    return total_samples;
+}
+
+void Best_arm_identification::add_samples(size_t arm, const std::vector<double>& samples)
+{
+    for (double sample : samples)
+    {
+        statistics_[arm].push(sample);
+    }
+    samples_[arm].insert(samples_[arm].end(), samples.begin(), samples.end());
+}
+
+Best_arm_identification::State Best_arm_identification::finish_round()
+{
+    round_++;
+
+    std::sort(arms_.begin(), arms_.end(), [this](size_t left, size_t right) {
+        double left_mean = statistics_[left].get_mean();
+        double right_mean = statistics_[right].get_mean();
+        return left_mean > right_mean || (left_mean == right_mean && left < right);
+    });
+
+    // Compares every challenger to the leader on the samples both have
+    const std::vector<double>& leader_samples = samples_[arms_.front()];
+    double n_comparisons = static_cast<double>(std::max(arms_.size() - 1, size_t{1}));
+    double round = static_cast<double>(round_);
+    round_confidence_ = 1 - (1 - confidence_) / (n_comparisons * round * (round + 1));
+    std::vector<double> separation(arms_.size());
+    for (size_t k = 1; k < arms_.size(); k++)
+    {
+        const std::vector<double>& samples = samples_[arms_[k]];
+        size_t n_common = std::min(samples.size(), leader_samples.size());
+        Statistics::Running_statistics difference;
+        for (size_t j = 0; j < n_common; j++)
+        {
+            difference.push(leader_samples[j] - samples[j]);
+        }
+        // The difference is separated from zero once it exceeds the confidence interval. Arms with the same sample in
+        // every draw can not be told apart by more samples.
+        double sample_std =
+            Statistics::sample_deviation(std::sqrt(difference.get_variance()), static_cast<int>(n_common - 1));
+        double quantile = Statistics::student_t_quantile(round_confidence_, static_cast<double>(n_common - 1));
+        separation[k] = (sample_std > 0) ? difference.get_mean() / (quantile * sample_std)
+                                         : std::numeric_limits<double>::infinity();
+    }
+
+    // Removes the arms separated from the leader, apart from the best min_kept_arms
+    std::vector<size_t> kept_arms;
+    std::vector<std::pair<double, size_t>> challengers;
+    kept_arms.reserve(arms_.size());
+    for (size_t k = 0; k < arms_.size(); k++)
+    {
+        bool is_challenger = k > 0 && separation[k] <= 1;
+        if (is_challenger)
+        {
+            challengers.emplace_back(separation[k], arms_[k]);
+        }
+        if (k == 0 || is_challenger || k < min_kept_arms_)
+        {
+            kept_arms.push_back(arms_[k]);
+        }
+        else
+        {
+            samples_[arms_[k]] = std::vector<double>();
+        }
+    }
+    arms_ = std::move(kept_arms);
+    if (challengers.empty())
+    {
+        return State::separated;
+    }
+
+    // Next round: the leader and the less separated half of the challengers
+    std::sort(challengers.begin(), challengers.end());
+    challengers.resize((challengers.size() + 1) / 2);
+    sampled_arms_ = {arms_.front()};
+    size_t furthest_block = get_block(samples_[arms_.front()].size());
+    for (const auto& challenger : challengers)
+    {
+        sampled_arms_.push_back(challenger.second);
+        furthest_block = std::max(furthest_block, get_block(samples_[challenger.second].size()));
+    }
+    if (furthest_block + 1 >= block_starts_.size())
+    {
+        return State::out_of_samples;
+    }
+    target_block_ = furthest_block + 1;
+    return State::running;
+}
@@ -1,11 +1,19 @@
 #include "../include/Combat_simulator.hpp"
 
 #include <algorithm>
+#include <array>
+#include <mutex>
 
 namespace
 {
 constexpr double rage_factor = 15.0 / 230.6 / 2.0;
 
+// Below this many fights per thread the thread startup cost is not worth it
+constexpr int min_batches_per_thread = 250;
+
+// Bounds the hit table cache when many buff combinations occur, e.g., with stacking crit procs
+constexpr size_t max_hit_table_cache_size = 32;
+
 // constexpr double rage_from_damage_taken(double damage)
 //{
 //    return damage * 5 / 2 / 230.6;
@@ -21,13 +29,13 @@ constexpr double armor_mitigation(double target_armor, int target_level)
     return target_armor / (target_armor + 400 + 85 * target_level);
 }
 
-std::vector<double> create_hit_table(double miss, double dodge, double glancing, double crit)
+std::array<double, Hit_table::n_thresholds> create_hit_table(double miss, double dodge, double glancing, double crit)
 {
     // Order -> Miss, parry, dodge, block, glancing, crit, hit.
     return {miss, miss + dodge, miss + dodge + glancing, miss + dodge + glancing + crit};
 }
 
-std::vector<double> create_hit_table_yellow(double miss, double dodge, double crit)
+std::array<double, Hit_table::n_thresholds> create_hit_table_yellow(double miss, double dodge, double crit)
 {
     double double_roll_factor = (100 - miss - dodge) / 100;
     // Order -> Miss, parry, dodge, block, glancing, crit, hit.
@@ -35,13 +43,14 @@ std::vector<double> create_hit_table_yellow(double miss, double dodge, double cr
     return {miss, miss + dodge, miss + dodge, miss + dodge + double_roll_factor * crit};
 }
 
-std::vector<double> create_multipliers(double glancing_factor, double bonus_crit_multiplier)
+std::array<double, Hit_table::n_outcomes> create_multipliers(double glancing_factor, double bonus_crit_multiplier)
 {
     // Order -> Miss, parry, dodge, block, glancing, crit, hit.
     return {0.0, 0.0, glancing_factor, 2.0 + bonus_crit_multiplier, 1.0};
 }
 } // namespace
 
+template <bool debug>
 void Combat_simulator::cout_damage_parse(Combat_simulator::Hit_type hit_type, Socket weapon_hand,
                                          Combat_simulator::Hit_outcome hit_outcome)
 {
@@ -52,23 +61,23 @@ void Combat_simulator::cout_damage_parse(Combat_simulator::Hit_type hit_type, So
             switch (hit_outcome.hit_result)
             {
             case Hit_result::glancing:
-                simulator_cout("Mainhand glancing hit for: ", int(hit_outcome.damage), " damage.");
+                simulator_cout<debug>("Mainhand glancing hit for: ", int(hit_outcome.damage), " damage.");
                 break;
             case Hit_result::hit:
-                simulator_cout("Mainhand white hit for: ", int(hit_outcome.damage), " damage.");
+                simulator_cout<debug>("Mainhand white hit for: ", int(hit_outcome.damage), " damage.");
                 break;
             case Hit_result::crit:
-                simulator_cout("Mainhand crit for: ", int(hit_outcome.damage), " damage.");
+                simulator_cout<debug>("Mainhand crit for: ", int(hit_outcome.damage), " damage.");
                 break;
             case Hit_result::dodge:
-                simulator_cout("Mainhand hit dodged");
+                simulator_cout<debug>("Mainhand hit dodged");
                 break;
             case Hit_result::miss:
-                simulator_cout("Mainhand hit missed");
+                simulator_cout<debug>("Mainhand hit missed");
                 break;
             case Hit_result::TBD:
                 // Should never happen
-                simulator_cout("BUG");
+                simulator_cout<debug>("BUG");
                 break;
             }
         }
@@ -77,22 +86,22 @@ void Combat_simulator::cout_damage_parse(Combat_simulator::Hit_type hit_type, So
             switch (hit_outcome.hit_result)
             {
             case Hit_result::glancing:
-                simulator_cout("BUG: Ability glanced for: ", int(hit_outcome.damage), " damage.");
+                simulator_cout<debug>("BUG: Ability glanced for: ", int(hit_outcome.damage), " damage.");
                 break;
             case Hit_result::hit:
-                simulator_cout("Ability hit for: ", int(hit_outcome.damage), " damage.");
+                simulator_cout<debug>("Ability hit for: ", int(hit_outcome.damage), " damage.");
                 break;
             case Hit_result::crit:
-                simulator_cout("Ability crit for: ", int(hit_outcome.damage), " damage.");
+                simulator_cout<debug>("Ability crit for: ", int(hit_outcome.damage), " damage.");
                 break;
             case Hit_result::dodge:
-                simulator_cout("Ability dodged");
+                simulator_cout<debug>("Ability dodged");
                 break;
             case Hit_result::miss:
-                simulator_cout("Ability missed");
+                simulator_cout<debug>("Ability missed");
                 break;
             case Hit_result::TBD:
-                simulator_cout("BUUUUUUUUUUGGGGGGGGG");
+                simulator_cout<debug>("BUUUUUUUUUUGGGGGGGGG");
                 break;
             }
         }
@@ -102,76 +111,68 @@ void Combat_simulator::cout_damage_parse(Combat_simulator::Hit_type hit_type, So
         switch (hit_outcome.hit_result)
         {
         case Hit_result::glancing:
-            simulator_cout("Offhand glancing hit for: ", int(hit_outcome.damage), " damage.");
+            simulator_cout<debug>("Offhand glancing hit for: ", int(hit_outcome.damage), " damage.");
             break;
         case Hit_result::hit:
-            simulator_cout("Offhand white hit for: ", int(hit_outcome.damage), " damage.");
+            simulator_cout<debug>("Offhand white hit for: ", int(hit_outcome.damage), " damage.");
             break;
         case Hit_result::crit:
-            simulator_cout("Offhand crit for: ", int(hit_outcome.damage), " damage.");
+            simulator_cout<debug>("Offhand crit for: ", int(hit_outcome.damage), " damage.");
             break;
         case Hit_result::dodge:
-            simulator_cout("Offhand hit dodged");
+            simulator_cout<debug>("Offhand hit dodged");
             break;
         case Hit_result::miss:
-            simulator_cout("Offhand hit missed");
+            simulator_cout<debug>("Offhand hit missed");
             break;
         case Hit_result::TBD:
-            simulator_cout("BUUUUUUUUUUGGGGGGGGG");
+            simulator_cout<debug>("BUUUUUUUUUUGGGGGGGGG");
             break;
         }
     }
 }
 
+template <bool debug>
 Combat_simulator::Hit_outcome Combat_simulator::generate_hit_mh(double damage, Hit_type hit_type, bool is_overpower)
 {
     if (hit_type == Hit_type::white)
     {
-        simulator_cout("Drawing outcome from MH hit table");
-        double random_var = get_uniform_random(100);
-        int outcome = std::lower_bound(hit_table_white_mh_.begin(), hit_table_white_mh_.end(), random_var) -
-                      hit_table_white_mh_.begin();
-        return {damage * damage_multipliers_white_mh_[outcome], Hit_result(outcome)};
+        simulator_cout<debug>("Drawing outcome from MH hit table");
+        int outcome = hit_table_white_mh_.roll(get_hit_roll(white_main_hand_stream));
+        return {damage * hit_table_white_mh_.get_multiplier(outcome), Hit_result(outcome)};
     }
     else
     {
-        simulator_cout("Drawing outcome from yellow table");
-        double random_var = get_uniform_random(100);
-        if (is_overpower)
-        {
-            int outcome = std::lower_bound(hit_table_overpower_.begin(), hit_table_overpower_.end(), random_var) -
-                          hit_table_overpower_.begin();
-            return {damage * damage_multipliers_yellow_[outcome], Hit_result(outcome)};
-        }
-        else
-        {
-            int outcome = std::lower_bound(hit_table_yellow_.begin(), hit_table_yellow_.end(), random_var) -
-                          hit_table_yellow_.begin();
-            return {damage * damage_multipliers_yellow_[outcome], Hit_result(outcome)};
-        }
+        simulator_cout<debug>("Drawing outcome from yellow table");
+        const Hit_table& hit_table = is_overpower ? hit_table_overpower_ : hit_table_yellow_;
+        int outcome = hit_table.roll(get_hit_roll(yellow_stream));
+        return {damage * hit_table.get_multiplier(outcome), Hit_result(outcome)};
     }
 }
 
+template <bool debug>
 Combat_simulator::Hit_outcome Combat_simulator::generate_hit_oh(double damage)
 {
     if (ability_queue_manager.is_ability_queued())
     {
-        simulator_cout("Drawing outcome from OH twohanded hit table");
-        double random_var = get_uniform_random(100);
-        int outcome = std::lower_bound(hit_table_two_hand_.begin(), hit_table_two_hand_.end(), random_var) -
-                      hit_table_two_hand_.begin();
-        return {damage * damage_multipliers_white_oh_[outcome], Hit_result(outcome)};
+        simulator_cout<debug>("Drawing outcome from OH twohanded hit table");
+        int outcome = hit_table_two_hand_.roll(get_hit_roll(white_off_hand_stream));
+        return {damage * hit_table_two_hand_.get_multiplier(outcome), Hit_result(outcome)};
     }
     else
     {
-        simulator_cout("Drawing outcome from OH hit table");
-        double random_var = get_uniform_random(100);
-        int outcome = std::lower_bound(hit_table_white_oh_.begin(), hit_table_white_oh_.end(), random_var) -
-                      hit_table_white_oh_.begin();
-        return {damage * damage_multipliers_white_oh_[outcome], Hit_result(outcome)};
+        simulator_cout<debug>("Drawing outcome from OH hit table");
+        int outcome = hit_table_white_oh_.roll(get_hit_roll(white_off_hand_stream));
+        return {damage * hit_table_white_oh_.get_multiplier(outcome), Hit_result(outcome)};
     }
 }
 
+// The hit table micro benchmark calls these directly, so they must exist even where the fight loop inlines them
+template Combat_simulator::Hit_outcome Combat_simulator::generate_hit_mh<false>(double damage, Hit_type hit_type,
+                                                                                bool is_overpower);
+template Combat_simulator::Hit_outcome Combat_simulator::generate_hit_oh<false>(double damage);
+
+template <bool debug>
 Combat_simulator::Hit_outcome Combat_simulator::generate_hit(const Weapon_sim& weapon, double damage,
                                                              Combat_simulator::Hit_type hit_type, Socket weapon_hand,
                                                              const Special_stats& special_stats, bool boss_target,
@@ -180,7 +181,7 @@ Combat_simulator::Hit_outcome Combat_simulator::generate_hit(const Weapon_sim& w
     Combat_simulator::Hit_outcome hit_outcome;
     if (weapon_hand == Socket::main_hand)
     {
-        hit_outcome = generate_hit_mh(damage, hit_type, is_overpower);
+        hit_outcome = generate_hit_mh<debug>(damage, hit_type, is_overpower);
         if (boss_target)
         {
             hit_outcome.damage *= armor_reduction_factor_ * (1 + special_stats.damage_multiplier);
@@ -189,11 +190,11 @@ Combat_simulator::Hit_outcome Combat_simulator::generate_hit(const Weapon_sim& w
         {
             hit_outcome.damage *= armor_reduction_factor_add * (1 + special_stats.damage_multiplier);
         }
-        cout_damage_parse(hit_type, weapon_hand, hit_outcome);
+        cout_damage_parse<debug>(hit_type, weapon_hand, hit_outcome);
     }
     else
     {
-        hit_outcome = generate_hit_oh(damage);
+        hit_outcome = generate_hit_oh<debug>(damage);
         if (boss_target)
         {
             hit_outcome.damage *= armor_reduction_factor_ * (1 + special_stats.damage_multiplier);
@@ -202,26 +203,20 @@ Combat_simulator::Hit_outcome Combat_simulator::generate_hit(const Weapon_sim& w
         {
             hit_outcome.damage *= armor_reduction_factor_add * (1 + special_stats.damage_multiplier);
         }
-        cout_damage_parse(hit_type, weapon_hand, hit_outcome);
+        cout_damage_parse<debug>(hit_type, weapon_hand, hit_outcome);
     }
     if (config.combat.deep_wounds)
     {
         if (hit_outcome.hit_result == Combat_simulator::Hit_result::crit)
         {
-            buff_manager_.add_over_time_effect(
-                {"Deep_wounds",
-                 {},
-                 0,
-                 (1 + special_stats.damage_multiplier) * weapon.swing(special_stats.attack_power) / 4,
-                 3,
-                 12},
-                int(time_keeper_.time));
+            deep_wounds.damage = (1 + special_stats.damage_multiplier) * weapon.swing(special_stats.attack_power) / 4;
+            buff_manager_.add_over_time_effect(deep_wounds, int(time_keeper_.time));
         }
     }
     if (hit_outcome.hit_result == Combat_simulator::Hit_result::dodge)
     {
-        simulator_cout("Overpower aura gained!");
-        buff_manager_.add("overpower_aura", {}, 5.0);
+        simulator_cout<debug>("Overpower aura gained!");
+        buff_manager_.add(Buff_manager::overpower_aura, {}, 5.0);
     }
     return hit_outcome;
 }
@@ -300,23 +295,68 @@ void Combat_simulator::compute_hit_table(int level_difference, int weapon_skill,
 
     if (weapon_hand == Socket::main_hand)
     {
-        hit_table_white_mh_ = create_hit_table(miss_chance, dodge_chance, glancing_chance, crit_chance);
-        damage_multipliers_white_mh_ = create_multipliers((100.0 - glancing_penalty) / 100.0, 0.0);
+        hit_table_white_mh_ = {create_hit_table(miss_chance, dodge_chance, glancing_chance, crit_chance),
+                               create_multipliers((100.0 - glancing_penalty) / 100.0, 0.0)};
 
-        hit_table_yellow_ = create_hit_table_yellow(two_hand_miss_chance, dodge_chance, crit_chance);
-        hit_table_overpower_ =
-            create_hit_table_yellow(two_hand_miss_chance, 0, crit_chance + 25 * config.talents.overpower - 3.0);
-        damage_multipliers_yellow_ = create_multipliers(1.0, 0.1 * config.talents.impale);
+        const auto yellow_multipliers = create_multipliers(1.0, 0.1 * config.talents.impale);
+        hit_table_yellow_ = {create_hit_table_yellow(two_hand_miss_chance, dodge_chance, crit_chance),
+                             yellow_multipliers};
+        hit_table_overpower_ = {
+            create_hit_table_yellow(two_hand_miss_chance, 0, crit_chance + 25 * config.talents.overpower - 3.0),
+            yellow_multipliers};
     }
     else
     {
-        hit_table_white_oh_ = create_hit_table(miss_chance, dodge_chance, glancing_chance, crit_chance);
-        damage_multipliers_white_oh_ = create_multipliers((100.0 - glancing_penalty) / 100.0, 0.0);
+        const auto white_multipliers = create_multipliers((100.0 - glancing_penalty) / 100.0, 0.0);
+        hit_table_white_oh_ = {create_hit_table(miss_chance, dodge_chance, glancing_chance, crit_chance),
+                               white_multipliers};
+        hit_table_two_hand_ = {create_hit_table(two_hand_miss_chance, dodge_chance, glancing_chance, crit_chance),
+                               white_multipliers};
+    }
+}
 
-        hit_table_two_hand_ = create_hit_table(two_hand_miss_chance, dodge_chance, glancing_chance, crit_chance);
+void Combat_simulator::update_hit_table(int level_difference, int weapon_skill, const Special_stats& special_stats,
+                                        Socket weapon_hand)
+{
+    for (const auto& entry : hit_table_cache_)
+    {
+        if (entry.critical_strike == special_stats.critical_strike && entry.hit == special_stats.hit &&
+            entry.weapon_skill == weapon_skill && entry.level_difference == level_difference &&
+            entry.weapon_hand == weapon_hand)
+        {
+            if (weapon_hand == Socket::main_hand)
+            {
+                hit_table_white_mh_ = entry.hit_tables[0];
+                hit_table_yellow_ = entry.hit_tables[1];
+                hit_table_overpower_ = entry.hit_tables[2];
+            }
+            else
+            {
+                hit_table_white_oh_ = entry.hit_tables[0];
+                hit_table_two_hand_ = entry.hit_tables[1];
+            }
+            return;
+        }
+    }
+
+    compute_hit_table(level_difference, weapon_skill, special_stats, weapon_hand);
+    if (hit_table_cache_.size() == max_hit_table_cache_size)
+    {
+        hit_table_cache_.clear();
+    }
+    if (weapon_hand == Socket::main_hand)
+    {
+        hit_table_cache_.push_back({special_stats.critical_strike, special_stats.hit, weapon_skill, level_difference,
+                                    weapon_hand, {hit_table_white_mh_, hit_table_yellow_, hit_table_overpower_}});
+    }
+    else
+    {
+        hit_table_cache_.push_back({special_stats.critical_strike, special_stats.hit, weapon_skill, level_difference,
+                                    weapon_hand, {hit_table_white_oh_, hit_table_two_hand_, Hit_table{}}});
     }
 }
 
+template <bool debug>
 void Combat_simulator::manage_flurry(Hit_result hit_result, Special_stats& special_stats, int& flurry_charges,
                                      bool is_ability)
 {
@@ -340,25 +380,27 @@ void Combat_simulator::manage_flurry(Hit_result hit_result, Special_stats& speci
         {
             special_stats -= {0, 0, 0, 0, 0.05 + 0.05 * config.talents.flurry};
         }
-        simulator_cout(flurry_charges, " flurry charges");
+        simulator_cout<debug>(flurry_charges, " flurry charges");
         assert(special_stats.haste > -.1);
         assert(special_stats.haste < 1.2);
     }
 }
 
+template <bool debug>
 void Combat_simulator::bloodthirst(Weapon_sim& main_hand_weapon, Special_stats& special_stats, double& rage,
                                    Damage_sources& damage_sources, int& flurry_charges)
 {
     if (config.dpr_settings.compute_dpr_bt_)
     {
-        get_uniform_random(100) < hit_table_yellow_[1] ? rage -= 6 : rage -= 30;
-        time_keeper_.blood_thirst_cd = 6.0;
-        time_keeper_.global_cd = 1.5;
+        get_uniform_random(yellow_stream, 100) < hit_table_yellow_.get_thresholds()[1] ? rage -= 6 : rage -= 30;
+        time_keeper_.blood_thirst_ready = time_keeper_.time + 6.0;
+        time_keeper_.global_ready = time_keeper_.time + 1.5;
         return;
     }
-    simulator_cout("Bloodthirst!");
+    simulator_cout<debug>("Bloodthirst!");
     double damage = special_stats.attack_power * 0.45;
-    auto hit_outcome = generate_hit(main_hand_weapon, damage, Hit_type::yellow, Socket::main_hand, special_stats);
+    auto hit_outcome =
+        generate_hit<debug>(main_hand_weapon, damage, Hit_type::yellow, Socket::main_hand, special_stats);
     if (hit_outcome.hit_result == Hit_result::dodge || hit_outcome.hit_result == Hit_result::miss)
     {
         rage -= 6;
@@ -366,32 +408,33 @@ void Combat_simulator::bloodthirst(Weapon_sim& main_hand_weapon, Special_stats&
     else
     {
         rage -= 30;
-        hit_effects(main_hand_weapon, main_hand_weapon, special_stats, rage, damage_sources, flurry_charges);
+        hit_effects<debug>(main_hand_weapon, main_hand_weapon, special_stats, rage, damage_sources, flurry_charges);
     }
-    time_keeper_.blood_thirst_cd = 6.0;
-    time_keeper_.global_cd = 1.5;
-    manage_flurry(hit_outcome.hit_result, special_stats, flurry_charges, true);
+    time_keeper_.blood_thirst_ready = time_keeper_.time + 6.0;
+    time_keeper_.global_ready = time_keeper_.time + 1.5;
+    manage_flurry<debug>(hit_outcome.hit_result, special_stats, flurry_charges, true);
     damage_sources.add_damage(Damage_source::bloodthirst, hit_outcome.damage, time_keeper_.time);
-    simulator_cout("Current rage: ", int(rage));
+    simulator_cout<debug>("Current rage: ", int(rage));
 }
 
+template <bool debug>
 void Combat_simulator::overpower(Weapon_sim& main_hand_weapon, Special_stats& special_stats, double& rage,
                                  Damage_sources& damage_sources, int& flurry_charges)
 {
     if (config.dpr_settings.compute_dpr_op_)
     {
         rage > 25 ? rage = 20 : rage -= 5;
-        buff_manager_.add("battle_stance", {-3.0, 0, 0}, 1.5);
-        time_keeper_.overpower_cd = 5.0;
-        time_keeper_.global_cd = 1.5;
+        buff_manager_.add(Buff_manager::battle_stance, {-3.0, 0, 0}, 1.5);
+        time_keeper_.overpower_ready = time_keeper_.time + 5.0;
+        time_keeper_.global_ready = time_keeper_.time + 1.5;
         return;
     }
-    simulator_cout("Changed stance: Battle Stance.");
-    simulator_cout("Overpower!");
-    buff_manager_.add("battle_stance", {-3.0, 0, 0}, 1.5);
+    simulator_cout<debug>("Changed stance: Battle Stance.");
+    simulator_cout<debug>("Overpower!");
+    buff_manager_.add(Buff_manager::battle_stance, {-3.0, 0, 0}, 1.5);
     double damage = main_hand_weapon.normalized_swing(special_stats.attack_power) + 35;
     auto hit_outcome =
-        generate_hit(main_hand_weapon, damage, Hit_type::yellow, Socket::main_hand, special_stats, true, true);
+        generate_hit<debug>(main_hand_weapon, damage, Hit_type::yellow, Socket::main_hand, special_stats, true, true);
     if (rage > 25)
     {
         rage_lost_stance_swap_ += rage - 25;
@@ -400,42 +443,42 @@ void Combat_simulator::overpower(Weapon_sim& main_hand_weapon, Special_stats& sp
     rage -= 5;
     if (hit_outcome.hit_result != Hit_result::miss)
     {
-        hit_effects(main_hand_weapon, main_hand_weapon, special_stats, rage, damage_sources, flurry_charges);
+        hit_effects<debug>(main_hand_weapon, main_hand_weapon, special_stats, rage, damage_sources, flurry_charges);
     }
-    time_keeper_.overpower_cd = 5.0;
-    time_keeper_.global_cd = 1.5;
-    manage_flurry(hit_outcome.hit_result, special_stats, flurry_charges, true);
+    time_keeper_.overpower_ready = time_keeper_.time + 5.0;
+    time_keeper_.global_ready = time_keeper_.time + 1.5;
+    manage_flurry<debug>(hit_outcome.hit_result, special_stats, flurry_charges, true);
     damage_sources.add_damage(Damage_source::overpower, hit_outcome.damage, time_keeper_.time);
-    simulator_cout("Current rage: ", int(rage));
+    simulator_cout<debug>("Current rage: ", int(rage));
 }
 
+template <bool debug>
 void Combat_simulator::whirlwind(Weapon_sim& main_hand_weapon, Special_stats& special_stats, double& rage,
                                  Damage_sources& damage_sources, int& flurry_charges)
 {
     if (config.dpr_settings.compute_dpr_ww_)
     {
         rage -= 25;
-        time_keeper_.whirlwind_cd = 10;
-        time_keeper_.global_cd = 1.5;
+        time_keeper_.whirlwind_ready = time_keeper_.time + 10.0;
+        time_keeper_.global_ready = time_keeper_.time + 1.5;
         return;
     }
-    simulator_cout("Whirlwind! #targets = boss + ", adds_in_melee_range, " adds");
-    simulator_cout("Whirlwind hits: ", std::min(adds_in_melee_range + 1, 4), " targets");
+    simulator_cout<debug>("Whirlwind! #targets = boss + ", adds_in_melee_range, " adds");
+    simulator_cout<debug>("Whirlwind hits: ", std::min(adds_in_melee_range + 1, 4), " targets");
     double damage = main_hand_weapon.normalized_swing(special_stats.attack_power);
-    std::vector<Hit_outcome> hit_outcomes{};
-    hit_outcomes.reserve(4);
+    std::array<Hit_outcome, 4> hit_outcomes{};
     for (int i = 0; i < std::min(adds_in_melee_range + 1, 4); i++)
     {
-        hit_outcomes.emplace_back(
-            generate_hit(main_hand_weapon, damage, Hit_type::yellow, Socket::main_hand, special_stats, i == 0));
+        hit_outcomes[i] = generate_hit<debug>(main_hand_weapon, damage, Hit_type::yellow, Socket::main_hand,
+                                              special_stats, i == 0);
     }
     rage -= 25;
     if (hit_outcomes[0].hit_result != Hit_result::dodge && hit_outcomes[0].hit_result != Hit_result::miss)
     {
-        hit_effects(main_hand_weapon, main_hand_weapon, special_stats, rage, damage_sources, flurry_charges);
+        hit_effects<debug>(main_hand_weapon, main_hand_weapon, special_stats, rage, damage_sources, flurry_charges);
     }
-    time_keeper_.whirlwind_cd = 10;
-    time_keeper_.global_cd = 1.5;
+    time_keeper_.whirlwind_ready = time_keeper_.time + 10.0;
+    time_keeper_.global_ready = time_keeper_.time + 1.5;
     Hit_result result_used_for_flurry = Hit_result::TBD;
     double total_damage = 0;
     for (const auto& hit_outcome : hit_outcomes)
@@ -446,55 +489,59 @@ void Combat_simulator::whirlwind(Weapon_sim& main_hand_weapon, Special_stats& sp
             result_used_for_flurry = Hit_result::crit;
         }
     }
-    manage_flurry(result_used_for_flurry, special_stats, flurry_charges, true);
+    manage_flurry<debug>(result_used_for_flurry, special_stats, flurry_charges, true);
     damage_sources.add_damage(Damage_source::whirlwind, total_damage, time_keeper_.time);
-    simulator_cout("Current rage: ", int(rage));
+    simulator_cout<debug>("Current rage: ", int(rage));
 }
 
+template <bool debug>
 void Combat_simulator::execute(Weapon_sim& main_hand_weapon, Special_stats& special_stats, double& rage,
                                Damage_sources& damage_sources, int& flurry_charges, double execute_rage_cost)
 {
     if (config.dpr_settings.compute_dpr_ex_)
     {
-        get_uniform_random(100) < hit_table_yellow_[1] ? rage *= 0.85 : rage -= 30;
+        get_uniform_random(yellow_stream, 100) < hit_table_yellow_.get_thresholds()[1] ? rage *= 0.85 : rage -= 30;
         double next_server_batch = std::fmod(time_keeper_.time, 0.4);
-        buff_manager_.add("execute_rage_batch", {}, 0.4 + next_server_batch);
-        time_keeper_.global_cd = 1.5;
+        buff_manager_.add(Buff_manager::execute_rage_batch, {}, 0.4 + next_server_batch);
+        time_keeper_.global_ready = time_keeper_.time + 1.5;
         return;
     }
-    simulator_cout("Execute!");
+    simulator_cout<debug>("Execute!");
     double damage = 600 + (rage - execute_rage_cost) * 15;
-    auto hit_outcome = generate_hit(main_hand_weapon, damage, Hit_type::yellow, Socket::main_hand, special_stats);
+    auto hit_outcome =
+        generate_hit<debug>(main_hand_weapon, damage, Hit_type::yellow, Socket::main_hand, special_stats);
     if (hit_outcome.hit_result == Hit_result::dodge || hit_outcome.hit_result == Hit_result::miss)
     {
         rage *= 0.85;
     }
     else
     {
-        hit_effects(main_hand_weapon, main_hand_weapon, special_stats, rage, damage_sources, flurry_charges);
+        hit_effects<debug>(main_hand_weapon, main_hand_weapon, special_stats, rage, damage_sources, flurry_charges);
     }
     double next_server_batch = std::fmod(time_keeper_.time, 0.4);
-    buff_manager_.add("execute_rage_batch", {}, 0.4 + next_server_batch);
+    buff_manager_.add(Buff_manager::execute_rage_batch, {}, 0.4 + next_server_batch);
     buff_manager_.rage_before_execute = rage;
-    time_keeper_.global_cd = 1.5;
-    manage_flurry(hit_outcome.hit_result, special_stats, flurry_charges, true);
+    time_keeper_.global_ready = time_keeper_.time + 1.5;
+    manage_flurry<debug>(hit_outcome.hit_result, special_stats, flurry_charges, true);
     damage_sources.add_damage(Damage_source::execute, hit_outcome.damage, time_keeper_.time);
-    simulator_cout("Current rage: ", int(rage));
+    simulator_cout<debug>("Current rage: ", int(rage));
 }
 
+template <bool debug>
 void Combat_simulator::hamstring(Weapon_sim& main_hand_weapon, Special_stats& special_stats, double& rage,
                                  Damage_sources& damage_sources, int& flurry_charges)
 {
     if (config.dpr_settings.compute_dpr_ha_)
     {
-        get_uniform_random(100) < hit_table_yellow_[1] ? rage -= 2 : rage -= 10;
-        time_keeper_.global_cd = 1.5;
+        get_uniform_random(yellow_stream, 100) < hit_table_yellow_.get_thresholds()[1] ? rage -= 2 : rage -= 10;
+        time_keeper_.global_ready = time_keeper_.time + 1.5;
         return;
     }
-    simulator_cout("Hamstring!");
+    simulator_cout<debug>("Hamstring!");
     double damage = 45;
-    auto hit_outcome = generate_hit(main_hand_weapon, damage, Hit_type::yellow, Socket::main_hand, special_stats);
-    time_keeper_.global_cd = 1.5;
+    auto hit_outcome =
+        generate_hit<debug>(main_hand_weapon, damage, Hit_type::yellow, Socket::main_hand, special_stats);
+    time_keeper_.global_ready = time_keeper_.time + 1.5;
     if (hit_outcome.hit_result == Hit_result::dodge || hit_outcome.hit_result == Hit_result::miss)
     {
         rage -= 2;
@@ -502,132 +549,205 @@ void Combat_simulator::hamstring(Weapon_sim& main_hand_weapon, Special_stats& sp
     else
     {
         rage -= 10;
-        hit_effects(main_hand_weapon, main_hand_weapon, special_stats, rage, damage_sources, flurry_charges);
+        hit_effects<debug>(main_hand_weapon, main_hand_weapon, special_stats, rage, damage_sources, flurry_charges);
     }
-    manage_flurry(hit_outcome.hit_result, special_stats, flurry_charges, true);
+    manage_flurry<debug>(hit_outcome.hit_result, special_stats, flurry_charges, true);
     damage_sources.add_damage(Damage_source::hamstring, hit_outcome.damage, time_keeper_.time);
-    simulator_cout("Current rage: ", int(rage));
+    simulator_cout<debug>("Current rage: ", int(rage));
 }
 
+template <bool debug>
 void Combat_simulator::hit_effects(Weapon_sim& weapon, Weapon_sim& main_hand_weapon, Special_stats& special_stats,
                                    double& rage, Damage_sources& damage_sources, int& flurry_charges,
                                    bool is_extra_attack)
 {
     for (const auto& hit_effect : weapon.hit_effects)
     {
-        double r = get_uniform_random(1);
-        if (r < hit_effect.probability)
+        roll_hit_effect<debug>(hit_effect, weapon, main_hand_weapon, special_stats, rage, damage_sources,
+                               flurry_charges, is_extra_attack);
+    }
+    // Hit effects from active use effects proc on both weapons
+    for (size_t i = 0; i < buff_manager_.hit_gains.size(); i++)
+    {
+        roll_hit_effect<debug>(*buff_manager_.hit_gains[i].hit_effect, weapon, main_hand_weapon, special_stats, rage,
+                               damage_sources, flurry_charges, is_extra_attack);
+    }
+}
+
+template <bool debug>
+void Combat_simulator::roll_hit_effect(const Hit_effect& hit_effect, Weapon_sim& weapon, Weapon_sim& main_hand_weapon,
+                                       Special_stats& special_stats, double& rage, Damage_sources& damage_sources,
+                                       int& flurry_charges, bool is_extra_attack)
+{
+    double r = get_uniform_random(effect_stream, 1);
+    if (r < hit_effect.probability)
+    {
+        if (hit_effect.type != Hit_effect::Type::damage_magic_guaranteed)
         {
-            if (hit_effect.type != Hit_effect::Type::damage_magic_guaranteed)
+            buff_manager_.increment_proc(hit_effect.id);
+        }
+        switch (hit_effect.type)
+        {
+        case Hit_effect::Type::extra_hit:
+            if (!is_extra_attack)
             {
-                buff_manager_.increment_proc(hit_effect.name);
+                simulator_cout<debug>("PROC: extra hit from: ", hit_effect.name);
+                swing_weapon<debug>(main_hand_weapon, main_hand_weapon, special_stats, rage, damage_sources,
+                                    flurry_charges, hit_effect.attack_power_boost, true);
             }
-            switch (hit_effect.type)
+            break;
+        case Hit_effect::Type::damage_magic:
+            damage_sources.add_damage(Damage_source::item_hit_effects, hit_effect.damage * 0.83 * 1.1,
+                                      time_keeper_.time);
+            simulator_cout<debug>("PROC: ", hit_effect.name, " does ", hit_effect.damage * 0.83 * 1.1,
+                                  " magic damage.");
+            break;
+        case Hit_effect::Type::damage_magic_guaranteed:
+            simulator_cout<debug>("Weapon swing with: ", hit_effect.name, " does ", hit_effect.damage * 0.83,
+                                  " magic damage.");
+            damage_sources.add_damage(Damage_source::item_hit_effects, hit_effect.damage * 0.83, time_keeper_.time,
+                                      false);
+            break;
+        case Hit_effect::Type::damage_physical:
+        {
+            auto hit = generate_hit<debug>(main_hand_weapon, hit_effect.damage, Hit_type::yellow, Socket::main_hand,
+                                           special_stats);
+            damage_sources.add_damage(Damage_source::item_hit_effects, hit.damage, time_keeper_.time);
+            if (debug)
             {
-            case Hit_effect::Type::extra_hit:
-                if (!is_extra_attack)
+                std::string result;
+                switch (hit.hit_result)
                 {
-                    simulator_cout("PROC: extra hit from: ", hit_effect.name);
-                    swing_weapon(main_hand_weapon, main_hand_weapon, special_stats, rage, damage_sources,
-                                 flurry_charges, hit_effect.attack_power_boost, true);
+                case Hit_result::hit:
+                    result = " hit";
+                    break;
+                case Hit_result::crit:
+                    result = " crit";
+                    break;
+                case Hit_result::dodge:
+                    result = " dodge";
+                    break;
+                case Hit_result::miss:
+                    result = " miss";
+                    break;
+                default:
+                    result = " bugs";
+                    break;
                 }
-                break;
-            case Hit_effect::Type::damage_magic:
-                damage_sources.add_damage(Damage_source::item_hit_effects, hit_effect.damage * 0.83 * 1.1,
-                                          time_keeper_.time);
-                simulator_cout("PROC: ", hit_effect.name, " does ", hit_effect.damage * 0.83 * 1.1, " magic damage.");
-                break;
-            case Hit_effect::Type::damage_magic_guaranteed:
-                simulator_cout("Weapon swing with: ", hit_effect.name, " does ", hit_effect.damage * 0.83,
-                               " magic damage.");
-                damage_sources.add_damage(Damage_source::item_hit_effects, hit_effect.damage * 0.83, time_keeper_.time,
-                                          false);
-                break;
-            case Hit_effect::Type::damage_physical:
+                simulator_cout<debug>("PROC: ", hit_effect.name, result, " does ", int(hit.damage),
+                                      " physical damage");
+            }
+        }
+        break;
+        case Hit_effect::Type::stat_boost:
+            simulator_cout<debug>("PROC: ", hit_effect.name, " stats increased for ", hit_effect.duration, "s");
+            buff_manager_.add(weapon.proc_buff_ids[hit_effect.id],
+                              hit_effect.get_special_stat_equivalent(special_stats), hit_effect.duration);
+            break;
+        case Hit_effect::Type::reduce_armor:
+        {
+            if (current_armor_red_stacks_ < hit_effect.max_stacks)
             {
-                auto hit = generate_hit(main_hand_weapon, hit_effect.damage, Hit_type::yellow, Socket::main_hand,
-                                        special_stats);
-                damage_sources.add_damage(Damage_source::item_hit_effects, hit.damage, time_keeper_.time);
-                if (config.display_combat_debug)
-                {
-                    std::string result;
-                    switch (hit.hit_result)
-                    {
-                    case Hit_result::hit:
-                        result = " hit";
-                        break;
-                    case Hit_result::crit:
-                        result = " crit";
-                        break;
-                    case Hit_result::dodge:
-                        result = " dodge";
-                        break;
-                    case Hit_result::miss:
-                        result = " miss";
-                        break;
-                    default:
-                        result = " bugs";
-                        break;
-                    }
-                    simulator_cout("PROC: ", hit_effect.name, result, " does ", int(hit.damage), " physical damage");
-                }
+                target_armor_ -= hit_effect.armor_reduction;
+                target_armor_ = std::max(target_armor_, 0.0);
+                current_armor_red_stacks_++;
+                double target_mitigation = armor_mitigation(target_armor_, 63);
+                armor_reduction_factor_ = 1 - target_mitigation;
+                simulator_cout<debug>("PROC: ", hit_effect.name, " armor reduced by ",
+                                      int(hit_effect.armor_reduction), ". Target armor: ", int(target_armor_),
+                                      ". New mitigation factor: ", target_mitigation,
+                                      "%. Current stacks: ", int(current_armor_red_stacks_));
             }
+            else
+            {
+                simulator_cout<debug>("PROC: ", hit_effect.name,
+                                      ". Cant add more stacks. Current stacks: ", int(current_armor_red_stacks_));
+            }
+        }
+        break;
+        default:
+            std::cout << ":::::::::::FAULTY HIT EFFECT IN SIMULATION!!!:::::::::";
             break;
-            case Hit_effect::Type::stat_boost:
-                simulator_cout("PROC: ", hit_effect.name, " stats increased for ", hit_effect.duration, "s");
-                buff_manager_.add(weapon.socket_name + "_" + hit_effect.name,
-                                  hit_effect.get_special_stat_equivalent(special_stats), hit_effect.duration);
-                break;
-            case Hit_effect::Type::reduce_armor:
+        }
+    }
+}
+
+void Combat_simulator::register_buff_ids(std::vector<Weapon_sim>& weapons, std::vector<Use_effect>& use_effects,
+                                         std::vector<Over_time_effect>& over_time_effects)
+{
+    deep_wounds.id = Buff_manager::deep_wounds;
+    for (auto& over_time_effect : over_time_effects)
+    {
+        over_time_effect.id = buff_manager_.get_id(over_time_effect.name);
+    }
+    for (auto& use_effect : use_effects)
+    {
+        use_effect.id = buff_manager_.get_id(use_effect.name);
+        for (auto& hit_effect : use_effect.hit_effects)
+        {
+            hit_effect.id = buff_manager_.get_id(hit_effect.name);
+        }
+        for (auto& over_time_effect : use_effect.over_time_effects)
+        {
+            over_time_effect.id = buff_manager_.get_id(over_time_effect.name);
+        }
+    }
+    for (auto& weapon : weapons)
+    {
+        for (auto& hit_effect : weapon.hit_effects)
+        {
+            hit_effect.id = buff_manager_.get_id(hit_effect.name);
+        }
+    }
+
+    // Stat boosts from use effects are added to both weapons, so every weapon needs an id for all of them
+    for (auto& weapon : weapons)
+    {
+        auto register_proc_buff = [this, &weapon](const Hit_effect& hit_effect) {
+            if (hit_effect.type == Hit_effect::Type::stat_boost)
             {
-                if (current_armor_red_stacks_ < hit_effect.max_stacks)
-                {
-                    target_armor_ -= hit_effect.armor_reduction;
-                    target_armor_ = std::max(target_armor_, 0.0);
-                    current_armor_red_stacks_++;
-                    double target_mitigation = armor_mitigation(target_armor_, 63);
-                    armor_reduction_factor_ = 1 - target_mitigation;
-                    simulator_cout("PROC: ", hit_effect.name, " armor reduced by ", int(hit_effect.armor_reduction),
-                                   ". Target armor: ", int(target_armor_),
-                                   ". New mitigation factor: ", target_mitigation,
-                                   "%. Current stacks: ", int(current_armor_red_stacks_));
-                }
-                else
+                if (weapon.proc_buff_ids.size() <= static_cast<size_t>(hit_effect.id))
                 {
-                    simulator_cout("PROC: ", hit_effect.name,
-                                   ". Cant add more stacks. Current stacks: ", int(current_armor_red_stacks_));
+                    weapon.proc_buff_ids.resize(hit_effect.id + 1, -1);
                 }
+                weapon.proc_buff_ids[hit_effect.id] = buff_manager_.get_id(weapon.socket_name + "_" + hit_effect.name);
             }
-            break;
-            default:
-                std::cout << ":::::::::::FAULTY HIT EFFECT IN SIMULATION!!!:::::::::";
-                break;
+        };
+        for (const auto& hit_effect : weapon.hit_effects)
+        {
+            register_proc_buff(hit_effect);
+        }
+        for (const auto& use_effect : use_effects)
+        {
+            for (const auto& hit_effect : use_effect.hit_effects)
+            {
+                register_proc_buff(hit_effect);
             }
         }
     }
 }
 
+template <bool debug>
 void Combat_simulator::swing_weapon(Weapon_sim& weapon, Weapon_sim& main_hand_weapon, Special_stats& special_stats,
                                     double& rage, Damage_sources& damage_sources, int& flurry_charges,
                                     double attack_power_bonus, bool is_extra_attack)
 {
-    std::vector<Hit_outcome> hit_outcomes{};
-    hit_outcomes.reserve(2);
+    std::array<Hit_outcome, 2> hit_outcomes{};
     double swing_damage = weapon.swing(special_stats.attack_power + attack_power_bonus);
     if (weapon.socket == Socket::off_hand)
     {
         swing_damage *= (0.5 + 0.025 * config.talents.dual_wield_specialization);
     }
-    weapon.internal_swing_timer = weapon.swing_speed / (1 + special_stats.haste);
+    weapon.next_swing = time_keeper_.time + weapon.swing_speed / (1 + special_stats.haste);
 
     // Check if heroic strike should be performed
     if (ability_queue_manager.heroic_strike_queued && weapon.socket == Socket::main_hand &&
         rage >= heroic_strike_rage_cost)
     {
-        simulator_cout("Performing heroic strike");
+        simulator_cout<debug>("Performing heroic strike");
         swing_damage += config.combat.heroic_strike_damage;
-        hit_outcomes.emplace_back(
-            generate_hit(main_hand_weapon, swing_damage, Hit_type::yellow, weapon.socket, special_stats));
+        hit_outcomes[0] =
+            generate_hit<debug>(main_hand_weapon, swing_damage, Hit_type::yellow, weapon.socket, special_stats);
         ability_queue_manager.heroic_strike_queued = false;
         if (hit_outcomes[0].hit_result == Hit_result::dodge || hit_outcomes[0].hit_result == Hit_result::miss)
         {
@@ -638,18 +758,18 @@ void Combat_simulator::swing_weapon(Weapon_sim& weapon, Weapon_sim& main_hand_we
             rage -= heroic_strike_rage_cost;
         }
         damage_sources.add_damage(Damage_source::heroic_strike, hit_outcomes[0].damage, time_keeper_.time);
-        simulator_cout("Current rage: ", int(rage));
+        simulator_cout<debug>("Current rage: ", int(rage));
     }
     else if (ability_queue_manager.cleave_queued && weapon.socket == Socket::main_hand && rage >= 20)
     {
-        simulator_cout("Performing cleave! #targets = boss + ", adds_in_melee_range, " adds");
-        simulator_cout("Cleave hits: ", std::min(adds_in_melee_range + 1, 2), " targets");
+        simulator_cout<debug>("Performing cleave! #targets = boss + ", adds_in_melee_range, " adds");
+        simulator_cout<debug>("Cleave hits: ", std::min(adds_in_melee_range + 1, 2), " targets");
         swing_damage += 50; // TODO talents
 
         for (int i = 0; i < std::min(adds_in_melee_range + 1, 2); i++)
         {
-            hit_outcomes.emplace_back(
-                generate_hit(main_hand_weapon, swing_damage, Hit_type::yellow, weapon.socket, special_stats, i == 0));
+            hit_outcomes[i] = generate_hit<debug>(main_hand_weapon, swing_damage, Hit_type::yellow, weapon.socket,
+                                                  special_stats, i == 0);
         }
         ability_queue_manager.cleave_queued = false;
         rage -= 20;
@@ -659,7 +779,7 @@ void Combat_simulator::swing_weapon(Weapon_sim& weapon, Weapon_sim& main_hand_we
             total_damage += hit_outcome.damage;
         }
         damage_sources.add_damage(Damage_source::cleave, total_damage, time_keeper_.time);
-        simulator_cout("Current rage: ", int(rage));
+        simulator_cout<debug>("Current rage: ", int(rage));
     }
     else
     {
@@ -668,20 +788,20 @@ void Combat_simulator::swing_weapon(Weapon_sim& weapon, Weapon_sim& main_hand_we
             if (ability_queue_manager.heroic_strike_queued)
             {
                 // Failed to pay rage for heroic strike
-                simulator_cout("Failed to pay rage for heroic strike");
+                simulator_cout<debug>("Failed to pay rage for heroic strike");
                 ability_queue_manager.heroic_strike_queued = false;
             }
             else
             {
                 // Failed to pay rage for cleave
-                simulator_cout("Failed to pay rage for cleave");
+                simulator_cout<debug>("Failed to pay rage for cleave");
                 ability_queue_manager.cleave_queued = false;
             }
         }
 
         // Otherwise do white hit
-        hit_outcomes.emplace_back(
-            generate_hit(main_hand_weapon, swing_damage, Hit_type::white, weapon.socket, special_stats));
+        hit_outcomes[0] =
+            generate_hit<debug>(main_hand_weapon, swing_damage, Hit_type::white, weapon.socket, special_stats);
         if (dpr_heroic_strike_queued_)
         {
             rage -= heroic_strike_rage_cost;
@@ -698,7 +818,7 @@ void Combat_simulator::swing_weapon(Weapon_sim& weapon, Weapon_sim& main_hand_we
         }
         if (hit_outcomes[0].hit_result == Hit_result::dodge)
         {
-            simulator_cout("Rage gained from enemy dodging");
+            simulator_cout<debug>("Rage gained from enemy dodging");
             rage += rage_generation(swing_damage * armor_reduction_factor_);
         }
         if (rage > 100.0)
@@ -706,7 +826,7 @@ void Combat_simulator::swing_weapon(Weapon_sim& weapon, Weapon_sim& main_hand_we
             rage_lost_capped_ += rage - 100.0;
             rage = 100.0;
         }
-        simulator_cout("Current rage: ", int(rage));
+        simulator_cout<debug>("Current rage: ", int(rage));
         if (weapon.socket == Socket::main_hand)
         {
             damage_sources.add_damage(Damage_source::white_mh, hit_outcomes[0].damage, time_keeper_.time);
@@ -726,14 +846,15 @@ void Combat_simulator::swing_weapon(Weapon_sim& weapon, Weapon_sim& main_hand_we
             break;
         }
     }
-    manage_flurry(result_used_for_flurry, special_stats, flurry_charges);
+    manage_flurry<debug>(result_used_for_flurry, special_stats, flurry_charges);
 
     if (hit_outcomes[0].hit_result != Hit_result::miss && hit_outcomes[0].hit_result != Hit_result::dodge)
     {
-        hit_effects(weapon, main_hand_weapon, special_stats, rage, damage_sources, flurry_charges, is_extra_attack);
+        hit_effects<debug>(weapon, main_hand_weapon, special_stats, rage, damage_sources, flurry_charges,
+                           is_extra_attack);
 
         // Unbridled wrath
-        if (get_uniform_random(1) < p_unbridled_wrath_)
+        if (get_uniform_random(effect_stream, 1) < p_unbridled_wrath_)
         {
             rage += 1;
             if (rage > 100.0)
@@ -741,7 +862,7 @@ void Combat_simulator::swing_weapon(Weapon_sim& weapon, Weapon_sim& main_hand_we
                 rage_lost_capped_ += rage - 100.0;
                 rage = 100.0;
             }
-            simulator_cout("Unbridled wrath. Current rage: ", int(rage));
+            simulator_cout<debug>("Unbridled wrath. Current rage: ", int(rage));
         }
     }
 }
@@ -749,8 +870,7 @@ void Combat_simulator::swing_weapon(Weapon_sim& weapon, Weapon_sim& main_hand_we
 void Combat_simulator::simulate(const Character& character, size_t n_simulations, double init_mean,
                                 double init_variance, size_t init_simulations)
 {
-    dps_mean_ = init_mean;
-    dps_variance_ = init_variance;
+    dps_statistics_ = Statistics::Running_statistics{init_simulations, init_mean, init_variance};
     config.n_batches = n_simulations;
     simulate(character, init_simulations, false, false);
 }
@@ -763,44 +883,73 @@ void Combat_simulator::simulate(const Character& character, size_t n_simulations
 
 void Combat_simulator::simulate(const Character& character, int init_iteration, bool compute_time_lapse,
                                 bool compute_histogram)
+{
+    // A nonzero init_iteration continues the DPS statistics of the earlier fights
+    if (init_iteration == 0)
+    {
+        dps_statistics_ = Statistics::Running_statistics{};
+    }
+    if (threads_supported() && config.n_threads > 1 && !config.display_combat_debug &&
+        config.n_batches >= 2 * min_batches_per_thread)
+    {
+        simulate_parallel(character, compute_time_lapse, compute_histogram);
+    }
+    else if (config.display_combat_debug)
+    {
+        simulate_fights<true>(character, init_iteration, compute_time_lapse, compute_histogram);
+    }
+    else
+    {
+        simulate_fights<false>(character, init_iteration, compute_time_lapse, compute_histogram);
+    }
+}
+
+template <bool debug>
+void Combat_simulator::simulate_fights(const Character& character, int init_iteration, bool compute_time_lapse,
+                                       bool compute_histogram)
 {
     int n_damage_batches = config.n_batches;
-    if (config.display_combat_debug)
+    if (debug)
     {
         debug_topic_ = "";
         n_damage_batches = 1;
     }
+    n_simulated_ = n_damage_batches;
     if (compute_time_lapse)
     {
         reset_time_lapse();
     }
     if (compute_histogram)
     {
-        init_histogram();
+        dps_sketch_ = Statistics::Quantile_sketch{};
     }
-    buff_manager_.aura_uptime.auras.clear();
+    buff_manager_.reset_aura_uptime();
     damage_distribution_ = Damage_sources{};
-    flurry_uptime_mh_ = 0;
-    flurry_uptime_oh_ = 0;
+    flurry_uptime_mh_ = Statistics::Running_statistics{};
+    flurry_uptime_oh_ = Statistics::Running_statistics{};
     rage_lost_execute_batch_ = 0;
     rage_lost_stance_swap_ = 0;
     rage_lost_capped_ = 0;
-    heroic_strike_uptime_ = 0;
+    heroic_strike_uptime_ = Statistics::Running_statistics{};
+    avg_rage_spent_executing_ = Statistics::Running_statistics{};
+    fight_dps_.clear();
+    if (record_fight_dps_)
+    {
+        fight_dps_.reserve(n_damage_batches);
+    }
     const auto starting_special_stats = character.total_special_stats;
+    hit_table_cache_.clear();
     std::vector<Weapon_sim> weapons;
     for (const auto& wep : character.weapons)
     {
         weapons.emplace_back(wep.swing_speed, wep.min_damage, wep.max_damage, wep.socket, wep.type, wep.weapon_socket,
                              wep.hit_effects);
         weapons.back().compute_weapon_damage(wep.buff.bonus_damage + starting_special_stats.bonus_damage);
-        compute_hit_table(config.opponent_level - character.level,
-                          get_weapon_skill(character.total_special_stats, wep.type), starting_special_stats,
-                          wep.socket);
+        update_hit_table(config.opponent_level - character.level,
+                         get_weapon_skill(character.total_special_stats, wep.type), starting_special_stats,
+                         wep.socket);
     }
 
-    auto hit_effects_mh = weapons[0].hit_effects;
-    auto hit_effects_oh = weapons[1].hit_effects;
-
     heroic_strike_rage_cost = 15.0 - config.talents.improved_heroic_strike;
     p_unbridled_wrath_ = config.talents.unbridled_wrath * 0.08;
     double execute_rage_cost = 15 - static_cast<int>(2.51 * config.talents.improved_execute);
@@ -816,10 +965,7 @@ void Combat_simulator::simulate(const Character& character, int init_iteration,
     }
 
     double sim_time = config.sim_time;
-    if (config.use_sim_time_ramp)
-    {
-        sim_time -= 2.0;
-    }
+    const int ramp_batches = (ramp_batches_ > 0) ? ramp_batches_ : n_damage_batches;
 
     // Pick out the best use effect if there are several that shares cooldown
     std::vector<Use_effect> use_effects_all = character.use_effects;
@@ -893,19 +1039,24 @@ void Combat_simulator::simulate(const Character& character, int init_iteration,
         }
     }
 
+    register_buff_ids(weapons, use_effects, over_time_effects);
+    std::vector<std::string> debug_msg;
+    Damage_sources damage_sources{};
+
     for (int iter = init_iteration; iter < n_damage_batches + init_iteration; iter++)
     {
+        for (size_t stream = 0; stream < random_engines_.size(); stream++)
+        {
+            random_engines_[stream].seed(static_cast<uint64_t>(config.seed) + (uint64_t{stream} << 32), fight_index_);
+        }
+        fight_index_++;
         time_keeper_.reset(); // Class variable that keeps track of the time spent, cooldowns, iteration number
         ability_queue_manager.reset();
         auto special_stats = starting_special_stats;
-        Damage_sources damage_sources{};
+        damage_sources.reset(compute_time_lapse);
         double rage = config.combat.initial_rage;
 
-        // Reset hit effects
-        weapons[0].hit_effects = hit_effects_mh;
-        weapons[1].hit_effects = hit_effects_oh;
-        buff_manager_.initialize(special_stats, use_effects, weapons[0].hit_effects, weapons[1].hit_effects,
-                                 config.performance_mode);
+        buff_manager_.initialize(special_stats, use_effects, config.performance_mode);
 
         for (const auto& over_time_effect : over_time_effects)
         {
@@ -933,13 +1084,13 @@ void Combat_simulator::simulate(const Character& character, int init_iteration,
 
         for (auto& wep : weapons)
         {
-            wep.internal_swing_timer = 0.0;
+            wep.next_swing = 0.0;
         }
 
         // To avoid local max/min results from running a specific run time
         if (config.use_sim_time_ramp)
         {
-            sim_time += 2.0 / n_damage_batches;
+            sim_time = config.sim_time - 2.0 + 2.0 * (ramp_offset_ + iter - init_iteration + 1) / ramp_batches;
         }
 
         // Combat configuration
@@ -954,48 +1105,41 @@ void Combat_simulator::simulate(const Character& character, int init_iteration,
         {
             adds_in_melee_range = 4;
             remove_adds_timer = sim_time / 2 / 4;
-            buff_manager_.add("sulfuron_demo_shout", {0, 0, -300}, 300);
+            buff_manager_.add(Buff_manager::sulfuron_demo_shout, {0, 0, -300}, 300);
         }
 
         while (time_keeper_.time < sim_time)
         {
-            double mh_dt = weapons[0].internal_swing_timer;
-            double oh_dt = (weapons.size() == 2) ? weapons[1].internal_swing_timer : 100.0;
-            double buff_dt = buff_manager_.get_dt(time_keeper_.time);
-            double dt = time_keeper_.get_dynamic_time_step(mh_dt, oh_dt, buff_dt, sim_time);
-            time_keeper_.increment(dt);
-            std::vector<std::string> debug_msg;
-            buff_manager_.increment(dt, time_keeper_.time, sim_time - time_keeper_.time, rage, rage_lost_stance_swap_,
-                                    rage_lost_execute_batch_, time_keeper_.global_cd, debug_msg,
-                                    config.display_combat_debug);
-            for (const auto& msg : debug_msg)
+            buff_manager_.increment<debug>(time_keeper_.time, sim_time - time_keeper_.time, rage,
+                                           rage_lost_stance_swap_, rage_lost_execute_batch_, time_keeper_.global_ready,
+                                           debug_msg);
+            if (debug)
             {
-                simulator_cout(msg);
+                for (const auto& msg : debug_msg)
+                {
+                    simulator_cout<debug>(msg);
+                }
+                debug_msg.clear();
             }
 
             if (buff_manager_.need_to_recompute_hittables)
             {
                 for (const auto& weapon : weapons)
                 {
-                    compute_hit_table(config.opponent_level - character.level,
-                                      get_weapon_skill(character.total_special_stats, weapon.weapon_type),
-                                      special_stats, weapon.socket);
+                    update_hit_table(config.opponent_level - character.level,
+                                     get_weapon_skill(character.total_special_stats, weapon.weapon_type),
+                                     special_stats, weapon.socket);
                 }
                 buff_manager_.need_to_recompute_hittables = false;
             }
 
-            if (sim_time - time_keeper_.time < 0.0)
-            {
-                break;
-            }
-
             if (time_keeper_.time > 6 && armor_reduction_delayed > 0 && apply_delayed_armor_reduction)
             {
                 target_armor_ -= armor_reduction_delayed; // Armor for Warrior class monsters
                 target_armor_ = std::max(target_armor_, 0.0);
                 target_mitigation = armor_mitigation(target_armor_, 63);
-                simulator_cout("Improved expose armor applied. Target armor: ", int(target_armor_),
-                               ". New mitigation factor: ", target_mitigation, "%.");
+                simulator_cout<debug>("Improved expose armor applied. Target armor: ", int(target_armor_),
+                                      ". New mitigation factor: ", target_mitigation, "%.");
                 armor_reduction_factor_ = 1 - target_mitigation;
                 apply_delayed_armor_reduction = false;
             }
@@ -1006,12 +1150,13 @@ void Combat_simulator::simulate(const Character& character, int init_iteration,
                 {
                     removed_adds++;
                     adds_in_melee_range--;
-                    simulator_cout("Add #", removed_adds, " dies. Targets left: boss + ", adds_in_melee_range, "adds");
+                    simulator_cout<debug>("Add #", removed_adds, " dies. Targets left: boss + ", adds_in_melee_range,
+                                          "adds");
                 }
             }
 
-            bool mh_swing = weapons[0].time_for_swing(dt);
-            bool oh_swing = (weapons.size() == 2) ? weapons[1].time_for_swing(dt) : false;
+            bool mh_swing = weapons[0].time_for_swing(time_keeper_.time);
+            bool oh_swing = (weapons.size() == 2) ? weapons[1].time_for_swing(time_keeper_.time) : false;
 
             if (mh_swing)
             {
@@ -1020,7 +1165,7 @@ void Combat_simulator::simulate(const Character& character, int init_iteration,
                 {
                     mh_hits_w_flurry++;
                 }
-                swing_weapon(weapons[0], weapons[0], special_stats, rage, damage_sources, flurry_charges);
+                swing_weapon<debug>(weapons[0], weapons[0], special_stats, rage, damage_sources, flurry_charges);
             }
 
             if (oh_swing)
@@ -1034,7 +1179,7 @@ void Combat_simulator::simulate(const Character& character, int init_iteration,
                 {
                     oh_hits_w_heroic++;
                 }
-                swing_weapon(weapons[1], weapons[0], special_stats, rage, damage_sources, flurry_charges);
+                swing_weapon<debug>(weapons[1], weapons[0], special_stats, rage, damage_sources, flurry_charges);
             }
 
             // Execute phase
@@ -1044,7 +1189,7 @@ void Combat_simulator::simulate(const Character& character, int init_iteration,
                 {
                     if (!execute_phase)
                     {
-                        simulator_cout("------------ Execute phase! ------------");
+                        simulator_cout<debug>("------------ Execute phase! ------------");
                         execute_phase = true;
                     }
                 }
@@ -1055,7 +1200,7 @@ void Combat_simulator::simulate(const Character& character, int init_iteration,
                 {
                     if (!execute_phase)
                     {
-                        simulator_cout("------------ Execute phase! ------------");
+                        simulator_cout<debug>("------------ Execute phase! ------------");
                         execute_phase = true;
                     }
                 }
@@ -1077,29 +1222,29 @@ void Combat_simulator::simulate(const Character& character, int init_iteration,
                         else
                         {
                             ability_queue_manager.queue_heroic_strike();
-                            simulator_cout("Heroic strike activated");
+                            simulator_cout<debug>("Heroic strike activated");
                         }
                     }
                 }
                 if (config.combat.use_bt_in_exec_phase)
                 {
-                    if (time_keeper_.blood_thirst_cd < 0.0 && time_keeper_.global_cd < 0 && rage > 30)
+                    if (time_keeper_.blood_thirst_cd() <= 0.0 && time_keeper_.global_cd() <= 0.0 && rage > 30)
                     {
-                        bloodthirst(weapons[0], special_stats, rage, damage_sources, flurry_charges);
+                        bloodthirst<debug>(weapons[0], special_stats, rage, damage_sources, flurry_charges);
                     }
                 }
-                if (time_keeper_.global_cd < 0 && rage > execute_rage_cost)
+                if (time_keeper_.global_cd() <= 0.0 && rage > execute_rage_cost)
                 {
-                    execute(weapons[0], special_stats, rage, damage_sources, flurry_charges, execute_rage_cost);
+                    execute<debug>(weapons[0], special_stats, rage, damage_sources, flurry_charges, execute_rage_cost);
                 }
             }
             else
             {
                 if (config.combat.use_bloodthirst)
                 {
-                    if (time_keeper_.blood_thirst_cd < 0.0 && time_keeper_.global_cd < 0 && rage > 30)
+                    if (time_keeper_.blood_thirst_cd() <= 0.0 && time_keeper_.global_cd() <= 0.0 && rage > 30)
                     {
-                        bloodthirst(weapons[0], special_stats, rage, damage_sources, flurry_charges);
+                        bloodthirst<debug>(weapons[0], special_stats, rage, damage_sources, flurry_charges);
                     }
                 }
 
@@ -1108,12 +1253,12 @@ void Combat_simulator::simulate(const Character& character, int init_iteration,
                     bool use_ww = true;
                     if (config.combat.use_bloodthirst)
                     {
-                        use_ww = time_keeper_.blood_thirst_cd > config.combat.whirlwind_bt_cooldown_thresh;
+                        use_ww = time_keeper_.blood_thirst_cd() > config.combat.whirlwind_bt_cooldown_thresh;
                     }
-                    if (time_keeper_.whirlwind_cd < 0.0 && rage > config.combat.whirlwind_rage_thresh && rage > 25 &&
-                        time_keeper_.global_cd < 0 && use_ww)
+                    if (time_keeper_.whirlwind_cd() <= 0.0 && rage > config.combat.whirlwind_rage_thresh && rage > 25 &&
+                        time_keeper_.global_cd() <= 0.0 && use_ww)
                     {
-                        whirlwind(weapons[0], special_stats, rage, damage_sources, flurry_charges);
+                        whirlwind<debug>(weapons[0], special_stats, rage, damage_sources, flurry_charges);
                     }
                 }
 
@@ -1122,16 +1267,16 @@ void Combat_simulator::simulate(const Character& character, int init_iteration,
                     bool use_op = true;
                     if (config.combat.use_bloodthirst)
                     {
-                        use_op &= time_keeper_.blood_thirst_cd > config.combat.overpower_bt_cooldown_thresh;
+                        use_op &= time_keeper_.blood_thirst_cd() > config.combat.overpower_bt_cooldown_thresh;
                     }
                     if (config.combat.use_whirlwind)
                     {
-                        use_op &= time_keeper_.whirlwind_cd > config.combat.overpower_ww_cooldown_thresh;
+                        use_op &= time_keeper_.whirlwind_cd() > config.combat.overpower_ww_cooldown_thresh;
                     }
-                    if (time_keeper_.overpower_cd < 0.0 && rage < config.combat.overpower_rage_thresh && rage > 5 &&
-                        time_keeper_.global_cd < 0 && buff_manager_.can_do_overpower() && use_op)
+                    if (time_keeper_.overpower_cd() <= 0.0 && rage < config.combat.overpower_rage_thresh && rage > 5 &&
+                        time_keeper_.global_cd() <= 0.0 && buff_manager_.can_do_overpower() && use_op)
                     {
-                        overpower(weapons[0], special_stats, rage, damage_sources, flurry_charges);
+                        overpower<debug>(weapons[0], special_stats, rage, damage_sources, flurry_charges);
                     }
                 }
 
@@ -1140,15 +1285,15 @@ void Combat_simulator::simulate(const Character& character, int init_iteration,
                     bool use_ham = true;
                     if (config.combat.use_bloodthirst)
                     {
-                        use_ham &= time_keeper_.blood_thirst_cd > config.combat.hamstring_cd_thresh;
+                        use_ham &= time_keeper_.blood_thirst_cd() > config.combat.hamstring_cd_thresh;
                     }
                     if (config.combat.use_whirlwind)
                     {
-                        use_ham &= time_keeper_.whirlwind_cd > config.combat.hamstring_cd_thresh;
+                        use_ham &= time_keeper_.whirlwind_cd() > config.combat.hamstring_cd_thresh;
                     }
-                    if (rage > config.combat.hamstring_thresh_dd && time_keeper_.global_cd < 0 && use_ham)
+                    if (rage > config.combat.hamstring_thresh_dd && time_keeper_.global_cd() <= 0.0 && use_ham)
                     {
-                        hamstring(weapons[0], special_stats, rage, damage_sources, flurry_charges);
+                        hamstring<debug>(weapons[0], special_stats, rage, damage_sources, flurry_charges);
                     }
                 }
 
@@ -1163,7 +1308,7 @@ void Combat_simulator::simulate(const Character& character, int init_iteration,
                         else
                         {
                             ability_queue_manager.queue_cleave();
-                            simulator_cout("Cleave activated");
+                            simulator_cout<debug>("Cleave activated");
                         }
                     }
                 }
@@ -1180,13 +1325,23 @@ void Combat_simulator::simulate(const Character& character, int init_iteration,
                             else
                             {
                                 ability_queue_manager.queue_heroic_strike();
-                                simulator_cout("Heroic strike activated");
+                                simulator_cout<debug>("Heroic strike activated");
                             }
                         }
                     }
                 }
             }
+
+            // Jump straight to the next swing, cooldown expiry, buff fade or over time tick
+            double next_event = std::min(weapons[0].next_swing, buff_manager_.next_event_time());
+            if (weapons.size() == 2)
+            {
+                next_event = std::min(next_event, weapons[1].next_swing);
+            }
+            next_event = std::min(next_event, time_keeper_.next_cooldown_event());
+            time_keeper_.time = std::min(next_event, sim_time);
         }
+        buff_manager_.finalize(sim_time);
         if (config.combat.deep_wounds)
         {
             double dw_average_damage = buff_manager_.deep_wounds_damage / buff_manager_.deep_wounds_timestamps.size();
@@ -1196,140 +1351,235 @@ void Combat_simulator::simulate(const Character& character, int init_iteration,
             }
         }
         double new_sample = damage_sources.sum_damage_sources() / sim_time;
-        dps_mean_ = Statistics::update_mean(dps_mean_, iter + 1, new_sample);
-        dps_variance_ = Statistics::update_variance(dps_variance_, dps_mean_, iter + 1, new_sample);
+        dps_statistics_.push(new_sample);
+        if (record_fight_dps_)
+        {
+            fight_dps_.push_back(new_sample);
+        }
         damage_distribution_ = damage_distribution_ + damage_sources;
-        flurry_uptime_mh_ = Statistics::update_mean(flurry_uptime_mh_, iter + 1, mh_hits_w_flurry / mh_hits);
-        flurry_uptime_oh_ = Statistics::update_mean(flurry_uptime_oh_, iter + 1, oh_hits_w_flurry / oh_hits);
-        heroic_strike_uptime_ = Statistics::update_mean(heroic_strike_uptime_, iter + 1, oh_hits_w_heroic / oh_hits);
-        avg_rage_spent_executing_ =
-            Statistics::update_mean(avg_rage_spent_executing_, iter + 1, buff_manager_.rage_spent_executing);
+        flurry_uptime_mh_.push(mh_hits_w_flurry / mh_hits);
+        flurry_uptime_oh_.push(oh_hits_w_flurry / oh_hits);
+        heroic_strike_uptime_.push(oh_hits_w_heroic / oh_hits);
+        avg_rage_spent_executing_.push(buff_manager_.rage_spent_executing);
         if (compute_time_lapse)
         {
             add_damage_source_to_time_lapse(damage_sources.damage_instances);
         }
         if (compute_histogram)
         {
-            hist_y[new_sample / 10.0]++;
+            dps_sketch_.push(new_sample);
+        }
+        if (progress_callback_ && (iter + 1 - init_iteration) % progress_interval == 0 &&
+            !progress_callback_(dps_statistics_))
+        {
+            // The results are normalized with the number of fights that were simulated
+            n_simulated_ = iter + 1 - init_iteration;
+            break;
         }
     }
     if (compute_time_lapse)
     {
         normalize_timelapse();
+    }}
+
+void Combat_simulator::simulate_parallel(const Character& character, bool compute_time_lapse, bool compute_histogram)
+{
+    const int n_batches = config.n_batches;
+    const int n_threads = std::min(config.n_threads, n_batches / min_batches_per_thread);
+
+    // Every worker owns its fight state and continues the fight indices where the previous worker stops, so the
+    // workers together simulate exactly the fights a serial run would have.
+    std::vector<Combat_simulator> workers(n_threads);
+    uint64_t fight_index = fight_index_;
+    for (int i = 0; i < n_threads; i++)
+    {
+        Combat_simulator_config worker_config = config;
+        worker_config.n_threads = 1;
+        worker_config.n_batches = n_batches / n_threads + (i < n_batches % n_threads ? 1 : 0);
+        workers[i].set_config(worker_config);
+        workers[i].set_fight_index(fight_index);
+        workers[i].ramp_offset_ = static_cast<int>(fight_index - fight_index_);
+        workers[i].ramp_batches_ = n_batches;
+        workers[i].record_fight_dps_ = record_fight_dps_;
+        fight_index += worker_config.n_batches;
+    }
+    fight_index_ = fight_index;
+
+    // The progress of all workers is reported as one, the first worker to be stopped stops the others as well
+    std::mutex progress_mutex;
+    std::vector<Statistics::Running_statistics> worker_statistics(n_threads);
+    bool stopped = false;
+    if (progress_callback_)
+    {
+        for (int i = 0; i < n_threads; i++)
+        {
+            workers[i].progress_callback_ = [this, i, &progress_mutex, &worker_statistics,
+                                             &stopped](const Statistics::Running_statistics& dps_statistics) {
+                std::lock_guard<std::mutex> lock{progress_mutex};
+                worker_statistics[i] = dps_statistics;
+                if (!stopped)
+                {
+                    Statistics::Running_statistics total = dps_statistics_;
+                    for (const auto& statistics : worker_statistics)
+                    {
+                        total.merge(statistics);
+                    }
+                    stopped = !progress_callback_(total);
+                }
+                return !stopped;
+            };
+        }
     }
-    if (compute_histogram)
+
+    std::vector<std::thread> threads;
+    threads.reserve(n_threads);
+    for (auto& worker : workers)
     {
-        prune_histogram();
+        threads.emplace_back([&worker, &character, compute_time_lapse, compute_histogram]() {
+            worker.simulate(character, 0, compute_time_lapse, compute_histogram);
+        });
     }
-}
-
-void Combat_simulator::init_histogram()
-{
-    double res = 10.0;
-    for (int i = 0; i < 500; i++)
+    for (auto& thread : threads)
     {
-        hist_x.push_back(i * res);
-        hist_y.push_back(0);
+        thread.join();
+    }
+    n_simulated_ = 0;
+    for (const auto& worker : workers)
+    {
+        n_simulated_ += worker.n_simulated_;
     }
-}
 
-void Combat_simulator::normalize_timelapse()
-{
-    for (auto& damage_time_lapse_i : damage_time_lapse)
+    if (compute_time_lapse)
     {
-        for (auto& singe_damage_instance : damage_time_lapse_i)
+        reset_time_lapse();
+    }
+    if (compute_histogram)
+    {
+        dps_sketch_ = Statistics::Quantile_sketch{};
+    }
+    buff_manager_.reset_aura_uptime();
+    damage_distribution_ = Damage_sources{};
+    flurry_uptime_mh_ = Statistics::Running_statistics{};
+    flurry_uptime_oh_ = Statistics::Running_statistics{};
+    rage_lost_execute_batch_ = 0;
+    rage_lost_stance_swap_ = 0;
+    rage_lost_capped_ = 0;
+    heroic_strike_uptime_ = Statistics::Running_statistics{};
+    avg_rage_spent_executing_ = Statistics::Running_statistics{};
+    fight_dps_.clear();
+
+    for (const auto& worker : workers)
+    {
+        dps_statistics_.merge(worker.dps_statistics_);
+        flurry_uptime_mh_.merge(worker.flurry_uptime_mh_);
+        flurry_uptime_oh_.merge(worker.flurry_uptime_oh_);
+        heroic_strike_uptime_.merge(worker.heroic_strike_uptime_);
+        avg_rage_spent_executing_.merge(worker.avg_rage_spent_executing_);
+        rage_lost_execute_batch_ += worker.rage_lost_execute_batch_;
+        rage_lost_stance_swap_ += worker.rage_lost_stance_swap_;
+        rage_lost_capped_ += worker.rage_lost_capped_;
+        damage_distribution_ = damage_distribution_ + worker.damage_distribution_;
+        fight_dps_.insert(fight_dps_.end(), worker.fight_dps_.begin(), worker.fight_dps_.end());
+        for (size_t i = 0; i < worker.buff_manager_.names.size(); i++)
         {
-            singe_damage_instance /= config.n_batches;
+            int id = buff_manager_.get_id(worker.buff_manager_.get_name(i));
+            buff_manager_.aura_uptime[id] += worker.buff_manager_.aura_uptime[i];
+            buff_manager_.increment_proc(id, worker.buff_manager_.procs[i]);
+        }
+        if (compute_time_lapse)
+        {
+            // The workers time lapses are already normalized with their own number of fights
+            double weight = static_cast<double>(worker.n_simulated_) / n_simulated_;
+            for (size_t i = 0; i < damage_time_lapse.size(); i++)
+            {
+                for (size_t j = 0; j < damage_time_lapse[i].size(); j++)
+                {
+                    damage_time_lapse[i][j] += worker.damage_time_lapse[i][j] * weight;
+                }
+            }
+        }
+        if (compute_histogram)
+        {
+            dps_sketch_.merge(worker.dps_sketch_);
         }
     }
+
+    hit_table_white_mh_ = workers[0].hit_table_white_mh_;
+    hit_table_white_oh_ = workers[0].hit_table_white_oh_;
+    hit_table_yellow_ = workers[0].hit_table_yellow_;
+    hit_table_overpower_ = workers[0].hit_table_overpower_;
+    hit_table_two_hand_ = workers[0].hit_table_two_hand_;
 }
 
-void Combat_simulator::prune_histogram()
+void Combat_simulator::normalize_timelapse()
 {
-    int start_idx{};
-    int end_idx{};
-    for (size_t i = 0; i < hist_x.size(); i++)
-    {
-        if (hist_y[i] != 0 && !start_idx)
-        {
-            start_idx = i;
-            break;
-        }
-    }
-    for (size_t i = hist_x.size() - 1; i > 0; i--)
+    for (auto& damage_time_lapse_i : damage_time_lapse)
     {
-        if (hist_y[i] != 0 && !end_idx)
+        for (auto& singe_damage_instance : damage_time_lapse_i)
         {
-            end_idx = i;
-            break;
+            singe_damage_instance /= n_simulated_;
         }
     }
-    {
-        auto first = hist_x.begin() + start_idx;
-        auto last = hist_x.begin() + end_idx + 1;
-        hist_x = std::vector<double>(first, last);
-    }
-    {
-        auto first = hist_y.begin() + start_idx;
-        auto last = hist_y.begin() + end_idx + 1;
-        hist_y = std::vector<int>(first, last);
-    }
 }
 
-const std::vector<double>& Combat_simulator::get_hit_probabilities_white_mh() const
+const std::array<double, Hit_table::n_thresholds>& Combat_simulator::get_hit_probabilities_white_mh() const
 {
-    return hit_table_white_mh_;
+    return hit_table_white_mh_.get_thresholds();
 }
 
-const std::vector<double>& Combat_simulator::get_hit_probabilities_white_oh() const
+const std::array<double, Hit_table::n_thresholds>& Combat_simulator::get_hit_probabilities_white_oh() const
 {
-    return hit_table_white_oh_;
+    return hit_table_white_oh_.get_thresholds();
 }
 
-const std::vector<double>& Combat_simulator::get_hit_probabilities_white_2h() const
+const std::array<double, Hit_table::n_thresholds>& Combat_simulator::get_hit_probabilities_white_2h() const
 {
-    return hit_table_two_hand_;
+    return hit_table_two_hand_.get_thresholds();
 }
 
-const std::vector<double>& Combat_simulator::get_hit_probabilities_yellow() const
+const std::array<double, Hit_table::n_thresholds>& Combat_simulator::get_hit_probabilities_yellow() const
 {
-    return hit_table_yellow_;
+    return hit_table_yellow_.get_thresholds();
 }
 
 double Combat_simulator::get_glancing_penalty_mh() const
 {
-    return damage_multipliers_white_mh_[2];
+    return hit_table_white_mh_.get_multiplier(static_cast<int>(Hit_result::glancing));
 }
 
 double Combat_simulator::get_glancing_penalty_oh() const
 {
-    return damage_multipliers_white_oh_[2];
+    return hit_table_white_oh_.get_multiplier(static_cast<int>(Hit_result::glancing));
 }
 
 std::vector<std::string> Combat_simulator::get_aura_uptimes() const
 {
     std::vector<std::string> aura_uptimes;
-    double total_sim_time = config.n_batches * config.sim_time;
-    for (const auto& aura : buff_manager_.aura_uptime.auras)
+    double total_sim_time = n_simulated_ * config.sim_time;
+    for (size_t i = 0; i < buff_manager_.names.size(); i++)
     {
-        std::string aura_name = aura.id;
-        double uptime = aura.duration / total_sim_time;
-        aura_uptimes.emplace_back(aura.id + " " + std::to_string(100 * uptime));
+        if (buff_manager_.aura_uptime[i] > 0.0)
+        {
+            double uptime = buff_manager_.aura_uptime[i] / total_sim_time;
+            aura_uptimes.emplace_back(buff_manager_.get_name(i) + " " + std::to_string(100 * uptime));
+        }
     }
-    aura_uptimes.emplace_back("Flurry_main_hand " + std::to_string(100 * flurry_uptime_mh_));
-    aura_uptimes.emplace_back("Flurry_off_hand " + std::to_string(100 * flurry_uptime_oh_));
-    aura_uptimes.emplace_back("'Heroic_strike_bug' " + std::to_string(100 * heroic_strike_uptime_));
+    aura_uptimes.emplace_back("Flurry_main_hand " + std::to_string(100 * flurry_uptime_mh_.get_mean()));
+    aura_uptimes.emplace_back("Flurry_off_hand " + std::to_string(100 * flurry_uptime_oh_.get_mean()));
+    aura_uptimes.emplace_back("'Heroic_strike_bug' " + std::to_string(100 * heroic_strike_uptime_.get_mean()));
     return aura_uptimes;
 }
 
 std::vector<std::string> Combat_simulator::get_proc_statistics() const
 {
     std::vector<std::string> proc_counter;
-    for (const auto& proc : buff_manager_.procs)
+    for (size_t i = 0; i < buff_manager_.names.size(); i++)
     {
-        std::string aura_name = proc.id;
-        double counter = static_cast<double>(proc.counter) / config.n_batches;
-        proc_counter.emplace_back(proc.id + " " + std::to_string(counter));
+        if (buff_manager_.procs[i] > 0)
+        {
+            double counter = static_cast<double>(buff_manager_.procs[i]) / n_simulated_;
+            proc_counter.emplace_back(buff_manager_.get_name(i) + " " + std::to_string(counter));
+        }
     }
     return proc_counter;
 }
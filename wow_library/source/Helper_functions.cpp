@@ -3,74 +3,8 @@
 double get_ap_equivalent(const Special_stats& special_stats, int relevant_skill, double swing_speed,
                          double weapon_damage)
 {
-    int target_defence_level = 315;
-    int skill_diff = target_defence_level - relevant_skill;
-    int base_skill_diff = 15;
-    double crit_chance = special_stats.critical_strike - base_skill_diff * 0.2 - 1.8; // 1.8 flat aura modifier
-
-    // Miss chance
-    double base_miss_chance;
-    int hit_penalty = 0;
-    if (skill_diff > 10)
-    {
-        base_miss_chance = 5.0 + skill_diff * 0.2;
-        hit_penalty = 1;
-    }
-    else if (skill_diff > 0)
-    {
-        base_miss_chance = 5.0 + skill_diff * 0.1;
-    }
-    else
-    {
-        base_miss_chance = 5.0;
-    }
-    double miss_chance_yellow = base_miss_chance + hit_penalty;
-    double dw_miss_chance = (base_miss_chance * 0.8 + 20.0);
-    double miss_chance = dw_miss_chance - std::max(special_stats.hit - hit_penalty, 0.0);
-
-    // Dodge chance
-    double dodge_chance = std::max(5 + skill_diff * 0.1, 5.0);
-    double crit_cap = 100 - (miss_chance + dodge_chance + 40);
-
-    double ap_equiv{};
-    if (crit_chance > crit_cap)
-    {
-        ap_equiv = (crit_chance - crit_cap) * crit_w_cap + crit_cap * crit_w;
-    }
-    else
-    {
-        ap_equiv = crit_chance * crit_w;
-    }
-
-    if (special_stats.hit > miss_chance_yellow)
-    {
-        ap_equiv += (special_stats.hit - miss_chance_yellow) * hit_w_cap + miss_chance_yellow * hit_w;
-    }
-    else
-    {
-        ap_equiv += special_stats.hit * hit_w;
-    }
-
-    // ish good estimation
-    ap_equiv += special_stats.chance_for_extra_hit / 2 * hit_w;
-
-    int extra_skill = relevant_skill - 300;
-    if (extra_skill > 0)
-    {
-        ap_equiv += std::min(5, extra_skill) * skill_w;
-    }
-    if (extra_skill > 5)
-    {
-        ap_equiv += std::min(5, extra_skill - 5) * skill_w_soft;
-    }
-    if (extra_skill > 10)
-    {
-        ap_equiv += extra_skill - 10 * skill_w_hard;
-    }
-
-    ap_equiv += (weapon_damage + special_stats.bonus_damage) / swing_speed * 14;
-
-    return ap_equiv;
+    return get_ap_equivalent(special_stats.critical_strike, special_stats.hit, special_stats.chance_for_extra_hit,
+                             special_stats.bonus_damage, relevant_skill, swing_speed, weapon_damage);
 }
 
 bool is_strictly_weaker(Special_stats special_stats1, Special_stats special_stats2)
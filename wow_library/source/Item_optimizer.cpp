@@ -1,77 +1,621 @@
 #include "Item_optimizer.hpp"
 
+#include <array>
+#include <functional>
+#include <numeric>
+#include <queue>
+
 bool operator<(const Item_optimizer::Sim_result_t& left, const Item_optimizer::Sim_result_t& right)
 {
     return left.mean_dps < right.mean_dps;
 }
 
-double Item_optimizer::get_total_qp_equivalent(const Special_stats& special_stats, const Weapon& wep1,
-                                               const Weapon& wep2, const std::vector<Use_effect>& use_effects)
+namespace
 {
-    double attack_power = special_stats.attack_power;
-    int main_hand_skill = get_skill_of_type(special_stats, wep1.type);
-    int off_hand_skill = get_skill_of_type(special_stats, wep2.type);
-    double main_hand_ap =
-        get_ap_equivalent(special_stats, main_hand_skill, wep1.swing_speed, (wep1.max_damage + wep1.min_damage) / 2);
-    double off_hand_ap =
-        get_ap_equivalent(special_stats, off_hand_skill, wep2.swing_speed, (wep2.max_damage + wep2.min_damage) / 2);
-    double use_effects_ap = 0;
-    double best_use_effects_shared_ap = 0;
-    for (const auto& effect : use_effects)
+double get_hit_effects_ap(const std::vector<Hit_effect>& hit_effects, double factor)
+{
+    double hit_effects_ap = 0;
+    for (const auto& effect : hit_effects)
     {
-        double use_effect_ap =
-            effect.get_special_stat_equivalent(special_stats).attack_power * std::min(effect.duration / sim_time, 1.0);
-        if (effect.name == "badge_of_the_swarmguard")
+        if (effect.type == Hit_effect::Type::damage_magic_guaranteed || effect.type == Hit_effect::Type::damage_magic ||
+            effect.type == Hit_effect::Type::damage_physical)
         {
-            use_effect_ap = 300 * std::min(effect.duration / sim_time, 1.0);
+            hit_effects_ap += effect.probability * effect.damage * ap_per_coh * factor;
         }
-        if (effect.effect_socket == Use_effect::Effect_socket::unique)
+        else if (effect.type == Hit_effect::Type::extra_hit)
         {
-            use_effects_ap += use_effect_ap;
+            hit_effects_ap += effect.probability * crit_w * factor;
         }
-        else
+        else if (effect.type == Hit_effect::Type::stat_boost)
         {
-            if (use_effect_ap > best_use_effects_shared_ap)
+            // Estimate empyrean demolisher as 10 DPS increase (okay since its only the filtering step)
+            hit_effects_ap += 140 * factor;
+        }
+    }
+    return hit_effects_ap;
+}
+
+// Hit effects from armor and buffs proc on both weapons, the off hand swings are weighted by half
+double get_dual_wield_hit_effects_ap(const std::vector<Hit_effect>& hit_effects)
+{
+    return get_hit_effects_ap(hit_effects, 1.0) + get_hit_effects_ap(hit_effects, 0.5);
+}
+
+// The stats that the AP estimate depends on, as plain numbers so that gear sets can be summed slot by slot without the
+// Special_stats bookkeeping. stat_factor is the product of (1 + stat_multiplier) over the sources.
+struct Ap_stats
+{
+    Ap_stats() = default;
+
+    Ap_stats(const Attributes& attributes, const Special_stats& special_stats)
+        : strength{attributes.strength}
+        , agility{attributes.agility}
+        , critical_strike{special_stats.critical_strike}
+        , hit{special_stats.hit}
+        , attack_power{special_stats.attack_power}
+        , chance_for_extra_hit{special_stats.chance_for_extra_hit}
+        , bonus_damage{special_stats.bonus_damage}
+        , sword_skill(special_stats.sword_skill)
+        , axe_skill(special_stats.axe_skill)
+        , dagger_skill(special_stats.dagger_skill)
+        , mace_skill(special_stats.mace_skill)
+        , fist_skill(special_stats.fist_skill)
+        , stat_factor{1 + special_stats.stat_multiplier}
+    {
+    }
+
+    Ap_stats& operator+=(const Ap_stats& rhs)
+    {
+        strength += rhs.strength;
+        agility += rhs.agility;
+        critical_strike += rhs.critical_strike;
+        hit += rhs.hit;
+        attack_power += rhs.attack_power;
+        chance_for_extra_hit += rhs.chance_for_extra_hit;
+        bonus_damage += rhs.bonus_damage;
+        sword_skill += rhs.sword_skill;
+        axe_skill += rhs.axe_skill;
+        dagger_skill += rhs.dagger_skill;
+        mace_skill += rhs.mace_skill;
+        fist_skill += rhs.fist_skill;
+        hit_effects_ap += rhs.hit_effects_ap;
+        stat_factor *= rhs.stat_factor;
+        return *this;
+    }
+
+    // Same as get_skill_of_type
+    double get_skill_of_type(Weapon_type weapon_type) const
+    {
+        switch (weapon_type)
+        {
+        case Weapon_type::sword:
+            return sword_skill;
+        case Weapon_type::axe:
+            return axe_skill;
+        case Weapon_type::dagger:
+            return dagger_skill;
+        case Weapon_type::mace:
+            return mace_skill;
+        case Weapon_type::unarmed:
+            return fist_skill;
+        default:
+            return 300;
+        }
+    }
+
+    double strength{};
+    double agility{};
+    double critical_strike{};
+    double hit{};
+    double attack_power{};
+    double chance_for_extra_hit{};
+    double bonus_damage{};
+    double sword_skill{};
+    double axe_skill{};
+    double dagger_skill{};
+    double mace_skill{};
+    double fist_skill{};
+    double hit_effects_ap{};
+    double stat_factor{1};
+};
+
+// A use effect reduced to what its AP estimate depends on, see Item_optimizer::get_use_effect_ap
+struct Ap_use_effect
+{
+    double get_ap(double stat_factor) const { return (strength * 2 * stat_factor + attack_power) * uptime; }
+
+    double strength;
+    double attack_power;
+    double uptime;
+    bool unique;
+};
+
+// The stats one item (or item pair) adds to a gear set, before the set bonuses and the stat conversion
+struct Slot_contribution
+{
+    Ap_stats stats{};
+    std::vector<size_t> set_ids{};
+    std::vector<Ap_use_effect> use_effects{};
+};
+
+struct Ap_weapons
+{
+    Weapon_type main_hand_type;
+    double main_hand_speed;
+    double main_hand_damage;
+    Weapon_type off_hand_type;
+    double off_hand_speed;
+    double off_hand_damage;
+};
+
+constexpr size_t ap_block_size = 128;
+
+// A block of gear sets as a struct of arrays, holding the summed stats before the stat conversion. flat_ap is the hit
+// and use effect estimate.
+struct Ap_block
+{
+    std::array<double, ap_block_size> strength;
+    std::array<double, ap_block_size> agility;
+    std::array<double, ap_block_size> critical_strike;
+    std::array<double, ap_block_size> hit;
+    std::array<double, ap_block_size> attack_power;
+    std::array<double, ap_block_size> chance_for_extra_hit;
+    std::array<double, ap_block_size> bonus_damage;
+    std::array<double, ap_block_size> stat_factor;
+    std::array<double, ap_block_size> main_hand_skill;
+    std::array<double, ap_block_size> main_hand_speed;
+    std::array<double, ap_block_size> main_hand_damage;
+    std::array<double, ap_block_size> off_hand_skill;
+    std::array<double, ap_block_size> off_hand_speed;
+    std::array<double, ap_block_size> off_hand_damage;
+    std::array<double, ap_block_size> flat_ap;
+    std::array<double, ap_block_size> ap_equivalent;
+};
+
+// Same estimate as Item_optimizer::get_total_qp_equivalent. All lanes are scored, also past the end of a partial
+// block, so that the loop has a fixed trip count and no calls left after inlining.
+void score_ap_block(Ap_block& block)
+{
+    for (size_t i = 0; i < ap_block_size; ++i)
+    {
+        double critical_strike = block.critical_strike[i] + block.agility[i] / 20 * block.stat_factor[i];
+        double attack_power = block.attack_power[i] + block.strength[i] * 2 * block.stat_factor[i];
+        double main_hand_ap =
+            get_ap_equivalent(critical_strike, block.hit[i], block.chance_for_extra_hit[i], block.bonus_damage[i],
+                              block.main_hand_skill[i], block.main_hand_speed[i], block.main_hand_damage[i]);
+        double off_hand_ap =
+            get_ap_equivalent(critical_strike, block.hit[i], block.chance_for_extra_hit[i], block.bonus_damage[i],
+                              block.off_hand_skill[i], block.off_hand_speed[i], block.off_hand_damage[i]);
+        block.ap_equivalent[i] = attack_power + (main_hand_ap + 0.625 * off_hand_ap) / 1.625 + block.flat_ap[i];
+    }
+}
+
+constexpr size_t weapon_slot = 13;
+
+// Everything the AP estimate depends on, reduced per slot option. Slot order and sizes follow combination_vector, see
+// Item_optimizer::get_item_ids.
+struct Ap_model
+{
+    Ap_stats get_set_bonus_stats(const std::vector<int>& set_counts) const
+    {
+        Ap_stats stats{};
+        for (size_t i = 0; i < set_bonus_stats.size(); ++i)
+        {
+            if (set_counts[set_bonus_ids[i]] >= set_bonus_pieces[i])
+            {
+                stats += set_bonus_stats[i];
+            }
+        }
+        return stats;
+    }
+
+    // Writes the gear set with the given items to a lane of the block. stats holds the constant, the slot
+    // contributions and the set bonuses.
+    void fill_lane(Ap_block& block, size_t lane, const Ap_stats& stats, const std::vector<size_t>& item_ids) const
+    {
+        double use_effects_ap = 0;
+        double best_use_effects_shared_ap = 0;
+        auto add_use_effect = [&](const Ap_use_effect& use_effect) {
+            double use_effect_ap = use_effect.get_ap(stats.stat_factor);
+            if (use_effect.unique)
+            {
+                use_effects_ap += use_effect_ap;
+            }
+            else if (use_effect_ap > best_use_effects_shared_ap)
             {
                 best_use_effects_shared_ap = use_effect_ap;
             }
+        };
+        for (size_t slot : use_effect_slots)
+        {
+            for (const auto& use_effect : contributions[slot][item_ids[slot]].use_effects)
+            {
+                add_use_effect(use_effect);
+            }
         }
+        for (const auto& use_effect : buff_use_effects)
+        {
+            add_use_effect(use_effect);
+        }
+
+        const Ap_weapons& weapon = weapons[item_ids[weapon_slot]];
+        block.strength[lane] = stats.strength;
+        block.agility[lane] = stats.agility;
+        block.critical_strike[lane] = stats.critical_strike;
+        block.hit[lane] = stats.hit;
+        block.attack_power[lane] = stats.attack_power;
+        block.chance_for_extra_hit[lane] = stats.chance_for_extra_hit;
+        block.bonus_damage[lane] = stats.bonus_damage;
+        block.stat_factor[lane] = stats.stat_factor;
+        block.main_hand_skill[lane] = stats.get_skill_of_type(weapon.main_hand_type);
+        block.main_hand_speed[lane] = weapon.main_hand_speed;
+        block.main_hand_damage[lane] = weapon.main_hand_damage;
+        block.off_hand_skill[lane] = stats.get_skill_of_type(weapon.off_hand_type);
+        block.off_hand_speed[lane] = weapon.off_hand_speed;
+        block.off_hand_damage[lane] = weapon.off_hand_damage;
+        block.flat_ap[lane] = use_effects_ap + best_use_effects_shared_ap + stats.hit_effects_ap;
     }
-    double hit_effects_ap = 0;
-    for (const auto& effect : wep1.hit_effects)
+
+    std::vector<std::vector<Slot_contribution>> contributions;
+    std::vector<Ap_weapons> weapons;
+    Ap_stats constant{};
+    std::vector<Ap_use_effect> buff_use_effects;
+    std::vector<size_t> use_effect_slots;
+    size_t n_counted_sets{};
+    std::vector<size_t> set_bonus_ids;
+    std::vector<int> set_bonus_pieces;
+    std::vector<Ap_stats> set_bonus_stats;
+};
+
+Ap_stats max_of(const Ap_stats& a, const Ap_stats& b)
+{
+    Ap_stats stats;
+    stats.strength = std::max(a.strength, b.strength);
+    stats.agility = std::max(a.agility, b.agility);
+    stats.critical_strike = std::max(a.critical_strike, b.critical_strike);
+    stats.hit = std::max(a.hit, b.hit);
+    stats.attack_power = std::max(a.attack_power, b.attack_power);
+    stats.chance_for_extra_hit = std::max(a.chance_for_extra_hit, b.chance_for_extra_hit);
+    stats.bonus_damage = std::max(a.bonus_damage, b.bonus_damage);
+    stats.sword_skill = std::max(a.sword_skill, b.sword_skill);
+    stats.axe_skill = std::max(a.axe_skill, b.axe_skill);
+    stats.dagger_skill = std::max(a.dagger_skill, b.dagger_skill);
+    stats.mace_skill = std::max(a.mace_skill, b.mace_skill);
+    stats.fist_skill = std::max(a.fist_skill, b.fist_skill);
+    stats.hit_effects_ap = std::max(a.hit_effects_ap, b.hit_effects_ap);
+    stats.stat_factor = std::max(a.stat_factor, b.stat_factor);
+    return stats;
+}
+
+Ap_stats min_of(const Ap_stats& a, const Ap_stats& b)
+{
+    Ap_stats stats;
+    stats.strength = std::min(a.strength, b.strength);
+    stats.agility = std::min(a.agility, b.agility);
+    stats.critical_strike = std::min(a.critical_strike, b.critical_strike);
+    stats.hit = std::min(a.hit, b.hit);
+    stats.attack_power = std::min(a.attack_power, b.attack_power);
+    stats.chance_for_extra_hit = std::min(a.chance_for_extra_hit, b.chance_for_extra_hit);
+    stats.bonus_damage = std::min(a.bonus_damage, b.bonus_damage);
+    stats.sword_skill = std::min(a.sword_skill, b.sword_skill);
+    stats.axe_skill = std::min(a.axe_skill, b.axe_skill);
+    stats.dagger_skill = std::min(a.dagger_skill, b.dagger_skill);
+    stats.mace_skill = std::min(a.mace_skill, b.mace_skill);
+    stats.fist_skill = std::min(a.fist_skill, b.fist_skill);
+    stats.hit_effects_ap = std::min(a.hit_effects_ap, b.hit_effects_ap);
+    stats.stat_factor = std::min(a.stat_factor, b.stat_factor);
+    return stats;
+}
+
+// Depth first search for the gear sets with the highest AP equivalents. The weapons are chosen first, then the other
+// slots, and a subtree is skipped when an upper bound of its AP equivalents cannot beat the n_best-th best set found so
+// far. For a given weapon skill the estimate grows with every stat, so the bound adds the per stat maximum of each
+// remaining slot to the chosen slots, assumes every set bonus that can still be completed and tries every skill value
+// that the remaining slots can lead to.
+class Ap_search
+{
+public:
+    Ap_search(const Ap_model& model, const std::vector<size_t>& cum_combination_vector, size_t n_best)
+        : model_(model), n_best_(n_best)
     {
-        if (effect.type == Hit_effect::Type::damage_magic_guaranteed || effect.type == Hit_effect::Type::damage_magic ||
-            effect.type == Hit_effect::Type::damage_physical)
+        const size_t n_slots = model.contributions.size();
+        slot_order_.push_back(weapon_slot);
+        for (size_t slot = n_slots - 1; slot-- > 0;)
         {
-            hit_effects_ap += effect.probability * effect.damage * ap_per_coh;
+            slot_order_.push_back(slot);
         }
-        else if (effect.type == Hit_effect::Type::extra_hit)
+        index_multipliers_.push_back(1);
+        index_multipliers_.insert(index_multipliers_.end(), cum_combination_vector.begin(),
+                                  cum_combination_vector.end() - 1);
+
+        // Options that look strong on their own are visited first, which raises the n_best-th best AP early
+        option_order_.resize(n_slots);
+        for (size_t slot = 0; slot < n_slots; ++slot)
         {
-            hit_effects_ap += effect.probability * crit_w;
+            std::vector<double> values;
+            for (const auto& contribution : model.contributions[slot])
+            {
+                const Ap_stats& stats = contribution.stats;
+                double value = stats.attack_power + stats.strength * 2 +
+                               (stats.critical_strike + stats.agility / 20) * crit_w + stats.hit * hit_w +
+                               stats.hit_effects_ap;
+                for (const auto& use_effect : contribution.use_effects)
+                {
+                    value += use_effect.get_ap(1.0);
+                }
+                values.push_back(value);
+            }
+            option_order_[slot].resize(values.size());
+            std::iota(option_order_[slot].begin(), option_order_[slot].end(), 0);
+            std::stable_sort(option_order_[slot].begin(), option_order_[slot].end(),
+                             [&values](size_t lhs, size_t rhs) { return values[lhs] > values[rhs]; });
         }
-        else if (effect.type == Hit_effect::Type::stat_boost)
+
+        // remaining_max_[depth] bounds what the slots from depth onwards can add, remaining_min_ the same from below
+        remaining_max_.resize(n_slots + 1);
+        remaining_min_.resize(n_slots + 1);
+        remaining_set_counts_.assign(n_slots + 1, std::vector<int>(model.n_counted_sets, 0));
+        for (size_t depth = n_slots; depth-- > 0;)
         {
-            // Estimate empyrean demolisher as 10 DPS increase (okay since its only the filtering step)
-            hit_effects_ap += 140;
+            const auto& options = model.contributions[slot_order_[depth]];
+            Ap_stats slot_max = options[0].stats;
+            Ap_stats slot_min = options[0].stats;
+            std::vector<int> slot_set_counts(model.n_counted_sets, 0);
+            for (const auto& option : options)
+            {
+                slot_max = max_of(slot_max, option.stats);
+                slot_min = min_of(slot_min, option.stats);
+                std::vector<int> option_set_counts(model.n_counted_sets, 0);
+                for (size_t set_id : option.set_ids)
+                {
+                    option_set_counts[set_id]++;
+                }
+                for (size_t set_id = 0; set_id < model.n_counted_sets; ++set_id)
+                {
+                    slot_set_counts[set_id] = std::max(slot_set_counts[set_id], option_set_counts[set_id]);
+                }
+            }
+            remaining_max_[depth] = remaining_max_[depth + 1];
+            remaining_max_[depth] += slot_max;
+            remaining_min_[depth] = remaining_min_[depth + 1];
+            remaining_min_[depth] += slot_min;
+            for (size_t set_id = 0; set_id < model.n_counted_sets; ++set_id)
+            {
+                remaining_set_counts_[depth][set_id] =
+                    remaining_set_counts_[depth + 1][set_id] + slot_set_counts[set_id];
+            }
         }
+
+        slot_depths_.resize(n_slots);
+        for (size_t depth = 0; depth < n_slots; ++depth)
+        {
+            slot_depths_[slot_order_[depth]] = depth;
+        }
+        item_ids_.assign(n_slots, 0);
+        partial_sums_.resize(n_slots + 1);
+        partial_sums_[0] = model.constant;
+        set_counts_.assign(model.n_counted_sets, 0);
     }
-    for (const auto& effect : wep2.hit_effects)
+
+    std::vector<Item_optimizer::Sim_result_t> run()
     {
-        if (effect.type == Hit_effect::Type::damage_magic_guaranteed || effect.type == Hit_effect::Type::damage_magic ||
-            effect.type == Hit_effect::Type::damage_physical)
+        search(0);
+        flush_block();
+        std::vector<Item_optimizer::Sim_result_t> best;
+        best.reserve(best_.size());
+        while (!best_.empty())
         {
-            hit_effects_ap += effect.probability * effect.damage * ap_per_coh * 0.5;
+            best.emplace_back(best_.top().second, 0, 0, best_.top().first);
+            best_.pop();
         }
-        else if (effect.type == Hit_effect::Type::extra_hit)
+        std::sort(best.begin(), best.end(),
+                  [](const Item_optimizer::Sim_result_t& lhs, const Item_optimizer::Sim_result_t& rhs) {
+                      return lhs.index < rhs.index;
+                  });
+        return best;
+    }
+
+    size_t get_visited_nodes() const { return visited_nodes_; }
+
+    size_t get_scored_sets() const { return scored_sets_; }
+
+private:
+    void search(size_t depth)
+    {
+        visited_nodes_++;
+        if (depth == slot_order_.size())
         {
-            hit_effects_ap += effect.probability * crit_w * 0.5;
+            Ap_stats stats = partial_sums_[depth];
+            stats += model_.get_set_bonus_stats(set_counts_);
+            model_.fill_lane(block_, block_size_, stats, item_ids_);
+            size_t index = 0;
+            for (size_t slot = 0; slot < item_ids_.size(); ++slot)
+            {
+                index += item_ids_[slot] * index_multipliers_[slot];
+            }
+            block_indices_[block_size_] = index;
+            if (++block_size_ == ap_block_size)
+            {
+                flush_block();
+            }
+            return;
         }
-        else if (effect.type == Hit_effect::Type::stat_boost)
+        if (depth > 0 && best_.size() == n_best_ && upper_bound(depth) < best_.top().first)
         {
-            // Estimate empyrean demolisher as 10 DPS increase (okay since its only the filtering step)
-            hit_effects_ap += 140 * 0.5;
+            return;
+        }
+        const size_t slot = slot_order_[depth];
+        for (size_t option : option_order_[slot])
+        {
+            const Slot_contribution& contribution = model_.contributions[slot][option];
+            item_ids_[slot] = option;
+            partial_sums_[depth + 1] = partial_sums_[depth];
+            partial_sums_[depth + 1] += contribution.stats;
+            for (size_t set_id : contribution.set_ids)
+            {
+                set_counts_[set_id]++;
+            }
+            search(depth + 1);
+            for (size_t set_id : contribution.set_ids)
+            {
+                set_counts_[set_id]--;
+            }
+        }
+    }
+
+    // Requires the weapons to be chosen, i.e., depth > 0
+    double upper_bound(size_t depth) const
+    {
+        Ap_stats stats = partial_sums_[depth];
+        stats += remaining_max_[depth];
+        Ap_stats lowest_skills = partial_sums_[depth];
+        lowest_skills += remaining_min_[depth];
+        for (size_t i = 0; i < model_.set_bonus_stats.size(); ++i)
+        {
+            size_t set_id = model_.set_bonus_ids[i];
+            if (set_counts_[set_id] + remaining_set_counts_[depth][set_id] >= model_.set_bonus_pieces[i])
+            {
+                stats += max_of(model_.set_bonus_stats[i], Ap_stats{});
+                lowest_skills += min_of(model_.set_bonus_stats[i], Ap_stats{});
+            }
+        }
+
+        double use_effects_ap = 0;
+        double best_use_effects_shared_ap = 0;
+        auto add_use_effects = [&](const std::vector<Ap_use_effect>& use_effects, double& unique_ap) {
+            for (const auto& use_effect : use_effects)
+            {
+                double use_effect_ap = use_effect.get_ap(stats.stat_factor);
+                if (use_effect.unique)
+                {
+                    unique_ap += use_effect_ap;
+                }
+                else
+                {
+                    best_use_effects_shared_ap = std::max(best_use_effects_shared_ap, use_effect_ap);
+                }
+            }
+        };
+        for (size_t slot : model_.use_effect_slots)
+        {
+            if (slot_depths_[slot] < depth)
+            {
+                add_use_effects(model_.contributions[slot][item_ids_[slot]].use_effects, use_effects_ap);
+            }
+            else
+            {
+                double best_unique_ap = 0;
+                for (const auto& option : model_.contributions[slot])
+                {
+                    double unique_ap = 0;
+                    add_use_effects(option.use_effects, unique_ap);
+                    best_unique_ap = std::max(best_unique_ap, unique_ap);
+                }
+                use_effects_ap += best_unique_ap;
+            }
+        }
+        add_use_effects(model_.buff_use_effects, use_effects_ap);
+
+        const Ap_weapons& weapon = model_.weapons[item_ids_[weapon_slot]];
+        double critical_strike = stats.critical_strike + stats.agility / 20 * stats.stat_factor;
+        auto best_weapon_ap = [&](Weapon_type type, double swing_speed, double damage) {
+            double best = -1e12;
+            for (double skill = lowest_skills.get_skill_of_type(type); skill <= stats.get_skill_of_type(type); ++skill)
+            {
+                best = std::max(best, get_ap_equivalent(critical_strike, stats.hit, stats.chance_for_extra_hit,
+                                                        stats.bonus_damage, skill, swing_speed, damage));
+            }
+            return best;
+        };
+        double main_hand_ap = best_weapon_ap(weapon.main_hand_type, weapon.main_hand_speed, weapon.main_hand_damage);
+        double off_hand_ap = best_weapon_ap(weapon.off_hand_type, weapon.off_hand_speed, weapon.off_hand_damage);
+        double bound = stats.attack_power + stats.strength * 2 * stats.stat_factor +
+                       (main_hand_ap + 0.625 * off_hand_ap) / 1.625 + use_effects_ap + best_use_effects_shared_ap +
+                       stats.hit_effects_ap;
+        // Margin for the different summation order of the bound
+        return bound + 1e-6 * std::abs(bound);
+    }
+
+    void flush_block()
+    {
+        score_ap_block(block_);
+        for (size_t lane = 0; lane < block_size_; ++lane)
+        {
+            if (best_.size() < n_best_)
+            {
+                best_.emplace(block_.ap_equivalent[lane], block_indices_[lane]);
+            }
+            else if (block_.ap_equivalent[lane] > best_.top().first)
+            {
+                best_.pop();
+                best_.emplace(block_.ap_equivalent[lane], block_indices_[lane]);
+            }
         }
+        scored_sets_ += block_size_;
+        block_size_ = 0;
+    }
+
+    const Ap_model& model_;
+    size_t n_best_;
+    std::vector<size_t> slot_order_;
+    std::vector<size_t> slot_depths_;
+    std::vector<size_t> index_multipliers_;
+    std::vector<std::vector<size_t>> option_order_;
+    std::vector<Ap_stats> remaining_max_;
+    std::vector<Ap_stats> remaining_min_;
+    std::vector<std::vector<int>> remaining_set_counts_;
+    std::vector<size_t> item_ids_;
+    std::vector<Ap_stats> partial_sums_;
+    std::vector<int> set_counts_;
+    Ap_block block_{};
+    std::array<size_t, ap_block_size> block_indices_{};
+    size_t block_size_{};
+    std::priority_queue<std::pair<double, size_t>, std::vector<std::pair<double, size_t>>,
+                        std::greater<std::pair<double, size_t>>>
+        best_;
+    size_t visited_nodes_{};
+    size_t scored_sets_{};
+};
+} // namespace
+
+double Item_optimizer::get_use_effect_ap(const Use_effect& use_effect, const Special_stats& special_stats) const
+{
+    if (use_effect.name == "badge_of_the_swarmguard")
+    {
+        return 300 * std::min(use_effect.duration / sim_time, 1.0);
     }
+    return use_effect.get_special_stat_equivalent(special_stats).attack_power *
+           std::min(use_effect.duration / sim_time, 1.0);
+}
+
+double Item_optimizer::get_total_qp_equivalent(const Special_stats& special_stats, const Weapon& wep1,
+                                               const Weapon& wep2, const std::vector<Use_effect>& use_effects)
+{
+    double attack_power = special_stats.attack_power;
+    int main_hand_skill = get_skill_of_type(special_stats, wep1.type);
+    int off_hand_skill = get_skill_of_type(special_stats, wep2.type);
+    double main_hand_ap =
+        get_ap_equivalent(special_stats, main_hand_skill, wep1.swing_speed, (wep1.max_damage + wep1.min_damage) / 2);
+    double off_hand_ap =
+        get_ap_equivalent(special_stats, off_hand_skill, wep2.swing_speed, (wep2.max_damage + wep2.min_damage) / 2);
+    double use_effects_ap = 0;
+    double best_use_effects_shared_ap = 0;
+    for (const auto& effect : use_effects)
+    {
+        double use_effect_ap = get_use_effect_ap(effect, special_stats);
+        if (effect.effect_socket == Use_effect::Effect_socket::unique)
+        {
+            use_effects_ap += use_effect_ap;
+        }
+        else
+        {
+            if (use_effect_ap > best_use_effects_shared_ap)
+            {
+                best_use_effects_shared_ap = use_effect_ap;
+            }
+        }
+    }
+    double hit_effects_ap = get_hit_effects_ap(wep1.hit_effects, 1.0) + get_hit_effects_ap(wep2.hit_effects, 0.5);
     return attack_power + (main_hand_ap + 0.625 * off_hand_ap) / 1.625 + use_effects_ap + best_use_effects_shared_ap +
            hit_effects_ap;
 }
@@ -865,4 +1409,270 @@ Character Item_optimizer::construct(size_t index)
     armory.compute_total_stats(character);
 
     return character;
-}
\ No newline at end of file
+}
+
+void Item_optimizer::cache_characters(const std::vector<Sim_result_t>& sim_results)
+{
+    character_cache.reserve(character_cache.size() + sim_results.size());
+    for (const auto& sim_result : sim_results)
+    {
+        if (character_cache.find(sim_result.index) == character_cache.end())
+        {
+            Character character = construct(sim_result.index);
+            character.armor = {};
+            character.buffs = {};
+            character.set_bonuses = {};
+            character_cache.emplace(sim_result.index, std::move(character));
+        }
+    }
+}
+
+void Item_optimizer::retain_cached_characters(const std::vector<Sim_result_t>& sim_results)
+{
+    std::unordered_map<size_t, Character> retained;
+    retained.reserve(sim_results.size());
+    for (const auto& sim_result : sim_results)
+    {
+        auto it = character_cache.find(sim_result.index);
+        if (it != character_cache.end())
+        {
+            retained.emplace(sim_result.index, std::move(it->second));
+        }
+    }
+    character_cache = std::move(retained);
+}
+
+namespace
+{
+Ap_model build_ap_model(Item_optimizer& item_optimizer, const Armory& armory)
+{
+    // Enchants and buffs do not depend on the items, so they are read from the first combination
+    Character reference = item_optimizer.generate_character(item_optimizer.get_item_ids(0));
+    armory.add_enchants_to_character(reference, item_optimizer.ench_vec);
+    armory.add_buffs_to_character(reference, item_optimizer.buffs_vec);
+
+    Ap_model model;
+
+    // Only the sets that have bonuses are counted
+    std::vector<Set> counted_sets;
+    for (const auto& set_bonus : armory.set_bonuses)
+    {
+        auto it = std::find(counted_sets.begin(), counted_sets.end(), set_bonus.set);
+        model.set_bonus_ids.push_back(it - counted_sets.begin());
+        if (it == counted_sets.end())
+        {
+            counted_sets.push_back(set_bonus.set);
+        }
+        model.set_bonus_pieces.push_back(set_bonus.pieces);
+        model.set_bonus_stats.emplace_back(set_bonus.attributes, set_bonus.special_stats);
+    }
+    model.n_counted_sets = counted_sets.size();
+
+    auto add_set = [&counted_sets](Slot_contribution& contribution, Set set) {
+        auto it = std::find(counted_sets.begin(), counted_sets.end(), set);
+        if (it != counted_sets.end())
+        {
+            contribution.set_ids.push_back(it - counted_sets.begin());
+        }
+    };
+    const double sim_time = item_optimizer.sim_time;
+    auto to_ap_use_effect = [sim_time](const Use_effect& use_effect) {
+        double uptime = std::min(use_effect.duration / sim_time, 1.0);
+        if (use_effect.name == "badge_of_the_swarmguard")
+        {
+            return Ap_use_effect{0.0, 300.0, uptime, use_effect.effect_socket == Use_effect::Effect_socket::unique};
+        }
+        return Ap_use_effect{use_effect.attribute_boost.strength, use_effect.special_stats_boost.attack_power, uptime,
+                             use_effect.effect_socket == Use_effect::Effect_socket::unique};
+    };
+    auto add_armor = [&](Slot_contribution& contribution, const Armor& armor, Enchant::Type enchant) {
+        contribution.stats += {armor.attributes, armor.special_stats};
+        contribution.stats += {armory.get_enchant_attributes(armor.socket, enchant),
+                               armory.get_enchant_special_stats(armor.socket, enchant)};
+        contribution.stats.hit_effects_ap += get_dual_wield_hit_effects_ap(armor.hit_effects);
+        add_set(contribution, armor.set_name);
+        for (const auto& use_effect : armor.use_effects)
+        {
+            contribution.use_effects.push_back(to_ap_use_effect(use_effect));
+        }
+    };
+    auto add_weapon = [&](Slot_contribution& contribution, Weapon weapon, Socket socket, Enchant::Type enchant,
+                          double hit_effect_factor) {
+        armory.clean_weapon(weapon);
+        auto enchant_hit_effect = armory.enchant_hit_effect(weapon.swing_speed, enchant);
+        if (enchant_hit_effect.type != Hit_effect::Type::none)
+        {
+            weapon.hit_effects.emplace_back(enchant_hit_effect);
+        }
+        contribution.stats += {weapon.attributes, weapon.special_stats};
+        contribution.stats += {armory.get_enchant_attributes(socket, enchant),
+                               armory.get_enchant_special_stats(socket, enchant)};
+        contribution.stats.hit_effects_ap += get_hit_effects_ap(weapon.hit_effects, hit_effect_factor);
+        add_set(contribution, weapon.set_name);
+    };
+
+    const std::vector<const std::vector<Armor>*> armor_slots{
+        &item_optimizer.helmets, &item_optimizer.necks, &item_optimizer.shoulders, &item_optimizer.backs,
+        &item_optimizer.chests,  &item_optimizer.wrists, &item_optimizer.hands,   &item_optimizer.belts,
+        &item_optimizer.legs,    &item_optimizer.boots,  &item_optimizer.ranged};
+    auto& contributions = model.contributions;
+    contributions.resize(item_optimizer.combination_vector.size());
+    for (size_t slot = 0; slot < armor_slots.size(); ++slot)
+    {
+        for (const auto& armor : *armor_slots[slot])
+        {
+            contributions[slot].emplace_back();
+            add_armor(contributions[slot].back(), armor, reference.armor[slot].enchant.type);
+        }
+    }
+    for (const auto& rings : item_optimizer.ring_combinations)
+    {
+        contributions[11].emplace_back();
+        add_armor(contributions[11].back(), rings[0], reference.armor[11].enchant.type);
+        add_armor(contributions[11].back(), rings[1], reference.armor[12].enchant.type);
+    }
+    for (const auto& trinkets : item_optimizer.trinket_combinations)
+    {
+        contributions[12].emplace_back();
+        add_armor(contributions[12].back(), trinkets[0], reference.armor[13].enchant.type);
+        add_armor(contributions[12].back(), trinkets[1], reference.armor[14].enchant.type);
+    }
+    for (const auto& weapon_combination : item_optimizer.weapon_combinations)
+    {
+        contributions[weapon_slot].emplace_back();
+        add_weapon(contributions[weapon_slot].back(), weapon_combination[0], Socket::main_hand,
+                   reference.weapons[0].enchant.type, 1.0);
+        add_weapon(contributions[weapon_slot].back(), weapon_combination[1], Socket::off_hand,
+                   reference.weapons[1].enchant.type, 0.5);
+        const Weapon& main_hand = weapon_combination[0];
+        const Weapon& off_hand = weapon_combination[1];
+        model.weapons.push_back({main_hand.type, main_hand.swing_speed,
+                                 (main_hand.max_damage + main_hand.min_damage) / 2, off_hand.type,
+                                 off_hand.swing_speed, (off_hand.max_damage + off_hand.min_damage) / 2});
+    }
+
+    model.constant = {reference.base_attributes, reference.base_special_stats};
+    model.constant.critical_strike += 5; // crit from talent
+    model.constant.critical_strike += 3; // crit from berserker stance
+    for (const auto& buff : reference.buffs)
+    {
+        model.constant += {buff.attributes, buff.special_stats};
+        for (const auto& use_effect : buff.use_effects)
+        {
+            model.buff_use_effects.push_back(to_ap_use_effect(use_effect));
+        }
+        for (const auto& hit_effect : buff.hit_effects)
+        {
+            if (hit_effect.name != "windfury_totem")
+            {
+                model.constant.hit_effects_ap += get_dual_wield_hit_effects_ap({hit_effect});
+            }
+            else
+            {
+                model.constant.hit_effects_ap += get_hit_effects_ap({hit_effect}, 1.0);
+            }
+        }
+    }
+
+    // Only a few slots have use effects, typically the trinkets
+    for (size_t slot = 0; slot < contributions.size(); ++slot)
+    {
+        for (const auto& contribution : contributions[slot])
+        {
+            if (!contribution.use_effects.empty())
+            {
+                model.use_effect_slots.push_back(slot);
+                break;
+            }
+        }
+    }
+    return model;
+}
+} // namespace
+
+std::vector<double> Item_optimizer::compute_ap_equivalents()
+{
+    const Ap_model model = build_ap_model(*this, armory);
+    const auto& contributions = model.contributions;
+
+    // partial_sums[slot] holds the contributions of the slots >= slot. The first slot changes on every index and the
+    // later slots only when the earlier ones wrap around, so on average about one slot is re-added per index.
+    const size_t n_slots = contributions.size();
+    std::vector<size_t> item_ids(n_slots, 0);
+    std::vector<int> set_counts(model.n_counted_sets, 0);
+    std::vector<Ap_stats> partial_sums(n_slots + 1);
+    partial_sums[n_slots] = model.constant;
+    size_t first_unchanged_slot = n_slots;
+    for (const auto& slot_contributions : contributions)
+    {
+        for (size_t set_id : slot_contributions[0].set_ids)
+        {
+            set_counts[set_id]++;
+        }
+    }
+    bool set_counts_changed = true;
+    Ap_stats set_bonus_stats{};
+
+    std::vector<double> ap_equivalents(total_combinations);
+    Ap_block block{};
+    for (size_t block_start = 0; block_start < total_combinations; block_start += ap_block_size)
+    {
+        const size_t block_end = std::min(block_start + ap_block_size, total_combinations);
+        for (size_t index = block_start; index < block_end; ++index)
+        {
+            if (index > 0)
+            {
+                for (size_t slot = 0; slot < n_slots; ++slot)
+                {
+                    for (size_t set_id : contributions[slot][item_ids[slot]].set_ids)
+                    {
+                        set_counts[set_id]--;
+                        set_counts_changed = true;
+                    }
+                    item_ids[slot] = (item_ids[slot] + 1) % combination_vector[slot];
+                    for (size_t set_id : contributions[slot][item_ids[slot]].set_ids)
+                    {
+                        set_counts[set_id]++;
+                        set_counts_changed = true;
+                    }
+                    if (item_ids[slot] != 0)
+                    {
+                        first_unchanged_slot = slot + 1;
+                        break;
+                    }
+                }
+            }
+            for (size_t slot = first_unchanged_slot; slot-- > 0;)
+            {
+                partial_sums[slot] = partial_sums[slot + 1];
+                partial_sums[slot] += contributions[slot][item_ids[slot]].stats;
+            }
+            if (set_counts_changed)
+            {
+                set_bonus_stats = model.get_set_bonus_stats(set_counts);
+                set_counts_changed = false;
+            }
+            Ap_stats stats = partial_sums[0];
+            stats += set_bonus_stats;
+            model.fill_lane(block, index - block_start, stats, item_ids);
+        }
+        score_ap_block(block);
+        std::copy(block.ap_equivalent.begin(), block.ap_equivalent.begin() + (block_end - block_start),
+                  ap_equivalents.begin() + block_start);
+    }
+    return ap_equivalents;
+}
+
+std::vector<Item_optimizer::Sim_result_t> Item_optimizer::find_best_ap_equivalents(size_t n_best,
+                                                                                     std::string& debug_message)
+{
+    const Ap_model model = build_ap_model(*this, armory);
+    Ap_search search{model, cum_combination_vector, n_best};
+    std::vector<Sim_result_t> best = search.run();
+    debug_message += "Branch and bound search scored " + std::to_string(search.get_scored_sets()) + " of " +
+                     std::to_string(total_combinations) + " sets, visiting " +
+                     std::to_string(search.get_visited_nodes()) + " nodes.<br>";
+    std::cout << "Branch and bound search scored " << search.get_scored_sets() << " of " << total_combinations
+              << " sets, visiting " << search.get_visited_nodes() << " nodes.\n";
+    return best;
+}
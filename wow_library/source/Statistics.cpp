@@ -1,6 +1,11 @@
 #include "Statistics.hpp"
 
+#include <algorithm>
+#include <cassert>
 #include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
 
 namespace Statistics
 {
@@ -40,21 +45,295 @@ double add_standard_deviations(double std1, double std2)
     return std::sqrt(std1 * std1 + std2 * std2);
 }
 
+std::string Running_statistics::serialize() const
+{
+    // 17 significant digits convert back to the same double
+    std::ostringstream stream;
+    stream << std::setprecision(17) << count_ << " " << mean_ << " " << sum_squared_deviations_;
+    return stream.str();
+}
+
+bool Running_statistics::deserialize(const std::string& serialized)
+{
+    std::istringstream stream{serialized};
+    Running_statistics statistics;
+    if (!(stream >> statistics.count_ >> statistics.mean_ >> statistics.sum_squared_deviations_))
+    {
+        return false;
+    }
+    *this = statistics;
+    return true;
+}
+
+Quantile_sketch::Quantile_sketch(double relative_accuracy, size_t max_buckets)
+    : relative_accuracy_{relative_accuracy}
+    , gamma_{(1.0 + relative_accuracy) / (1.0 - relative_accuracy)}
+    , inverse_log_gamma_{1.0 / std::log(gamma_)}
+    , max_buckets_{std::max(max_buckets, size_t{1})}
+{
+}
+
+void Quantile_sketch::push(double sample)
+{
+    count_++;
+    if (sample > 0.0)
+    {
+        add_to_bucket(get_bucket_index(sample), 1);
+    }
+    else
+    {
+        zero_count_++;
+    }
+}
+
+void Quantile_sketch::add_to_bucket(int index, size_t count)
+{
+    if (bucket_counts_.empty())
+    {
+        bucket_offset_ = index;
+        bucket_counts_.push_back(count);
+        return;
+    }
+    int highest_index = bucket_offset_ + static_cast<int>(bucket_counts_.size()) - 1;
+    if (index > highest_index)
+    {
+        bucket_counts_.resize(index - bucket_offset_ + 1, 0);
+        if (bucket_counts_.size() > max_buckets_)
+        {
+            // Collapses the lowest buckets into the lowest one that is kept
+            size_t n_collapsed = bucket_counts_.size() - max_buckets_;
+            for (size_t i = 0; i < n_collapsed; i++)
+            {
+                bucket_counts_[n_collapsed] += bucket_counts_[i];
+            }
+            bucket_counts_.erase(bucket_counts_.begin(), bucket_counts_.begin() + n_collapsed);
+            bucket_offset_ += static_cast<int>(n_collapsed);
+        }
+    }
+    else if (index < bucket_offset_)
+    {
+        int lowest_index = std::max(index, highest_index - static_cast<int>(max_buckets_) + 1);
+        bucket_counts_.insert(bucket_counts_.begin(), bucket_offset_ - lowest_index, 0);
+        bucket_offset_ = lowest_index;
+    }
+    bucket_counts_[std::max(index, bucket_offset_) - bucket_offset_] += count;
+}
+
+void Quantile_sketch::merge(const Quantile_sketch& other)
+{
+    assert(gamma_ == other.gamma_);
+    for (size_t i = 0; i < other.bucket_counts_.size(); i++)
+    {
+        if (other.bucket_counts_[i] > 0)
+        {
+            add_to_bucket(other.bucket_offset_ + static_cast<int>(i), other.bucket_counts_[i]);
+        }
+    }
+    count_ += other.count_;
+    zero_count_ += other.zero_count_;
+}
+
+double Quantile_sketch::get_quantile(double quantile) const
+{
+    if (count_ == 0)
+    {
+        return 0.0;
+    }
+    double rank = std::min(std::max(quantile, 0.0), 1.0) * static_cast<double>(count_ - 1);
+    size_t cumulative_count = zero_count_;
+    if (static_cast<double>(cumulative_count) > rank)
+    {
+        return 0.0;
+    }
+    for (size_t i = 0; i < bucket_counts_.size(); i++)
+    {
+        cumulative_count += bucket_counts_[i];
+        if (static_cast<double>(cumulative_count) > rank)
+        {
+            return get_bucket_value(bucket_offset_ + static_cast<int>(i));
+        }
+    }
+    return get_bucket_value(bucket_offset_ + static_cast<int>(bucket_counts_.size()) - 1);
+}
+
+void Quantile_sketch::get_histogram(double bin_width, std::vector<double>& bin_x, std::vector<int>& bin_count) const
+{
+    bin_x.clear();
+    bin_count.clear();
+    if (count_ == 0)
+    {
+        return;
+    }
+    auto get_bin = [bin_width](double value) { return static_cast<long>(std::floor(value / bin_width)); };
+    long first_bin = (zero_count_ > 0) ? 0 : get_bin(get_bucket_value(bucket_offset_));
+    long last_bin = first_bin;
+    if (!bucket_counts_.empty())
+    {
+        last_bin = get_bin(get_bucket_value(bucket_offset_ + static_cast<int>(bucket_counts_.size()) - 1));
+    }
+    for (long bin = first_bin; bin <= last_bin; bin++)
+    {
+        bin_x.push_back(static_cast<double>(bin) * bin_width);
+    }
+    bin_count.resize(bin_x.size());
+    bin_count[0] += static_cast<int>(zero_count_);
+    for (size_t i = 0; i < bucket_counts_.size(); i++)
+    {
+        long bin = get_bin(get_bucket_value(bucket_offset_ + static_cast<int>(i)));
+        bin_count[bin - first_bin] += static_cast<int>(bucket_counts_[i]);
+    }
+}
+
+std::string Quantile_sketch::serialize() const
+{
+    std::ostringstream stream;
+    stream << std::setprecision(17) << relative_accuracy_ << " " << max_buckets_ << " " << count_ << " "
+           << zero_count_ << " " << bucket_offset_ << " " << bucket_counts_.size();
+    for (size_t bucket_count : bucket_counts_)
+    {
+        stream << " " << bucket_count;
+    }
+    return stream.str();
+}
+
+bool Quantile_sketch::deserialize(const std::string& serialized)
+{
+    std::istringstream stream{serialized};
+    double relative_accuracy;
+    size_t max_buckets;
+    size_t n_buckets;
+    if (!(stream >> relative_accuracy >> max_buckets) || !(relative_accuracy > 0.0 && relative_accuracy < 1.0))
+    {
+        return false;
+    }
+    Quantile_sketch sketch{relative_accuracy, max_buckets};
+    if (!(stream >> sketch.count_ >> sketch.zero_count_ >> sketch.bucket_offset_ >> n_buckets) ||
+        n_buckets > sketch.max_buckets_)
+    {
+        return false;
+    }
+    sketch.bucket_counts_.resize(n_buckets);
+    for (auto& bucket_count : sketch.bucket_counts_)
+    {
+        if (!(stream >> bucket_count))
+        {
+            return false;
+        }
+    }
+    *this = sketch;
+    return true;
+}
+
 double normalCDF(double value)
 {
     return 0.5 * erfc(-value * M_SQRT1_2);
 }
 
-double find_cdf_quantile(double target_quantile, double precision)
+// Acklam's rational approximation, refined by one Halley step on normalCDF to full double precision
+double inverse_normal_cdf(double probability)
 {
-    double x = 0.0;
-    double quantile = 0.5;
-    while (quantile < target_quantile)
+    if (probability <= 0.0)
+    {
+        return -std::numeric_limits<double>::infinity();
+    }
+    if (probability >= 1.0)
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+    constexpr double a[] = {-3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+                            1.383577518672690e+02,  -3.066479806614716e+01, 2.506628277459239e+00};
+    constexpr double b[] = {-5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+                            6.680131188771972e+01, -1.328068155288572e+01};
+    constexpr double c[] = {-7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+                            -2.549732539343734e+00, 4.374664141464968e+00,  2.938163982698783e+00};
+    constexpr double d[] = {7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+                            3.754408661907416e+00};
+    constexpr double tail_probability = 0.02425;
+
+    double x;
+    if (probability < tail_probability || probability > 1.0 - tail_probability)
+    {
+        double q = std::sqrt(-2.0 * std::log(std::min(probability, 1.0 - probability)));
+        x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) /
+            ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+        if (probability > 0.5)
+        {
+            x = -x;
+        }
+    }
+    else
+    {
+        double q = probability - 0.5;
+        double r = q * q;
+        x = (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q /
+            (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1.0);
+    }
+
+    // The error of normalCDF(x) is computed in the tail that is closest, where it keeps its relative precision
+    double error = (x < 0) ? normalCDF(x) - probability : (1.0 - probability) - normalCDF(-x);
+    double u = error * std::sqrt(2.0 * M_PI) * std::exp(0.5 * x * x);
+    return x - u / (1.0 + 0.5 * x * u);
+}
+
+// Hill, "Algorithm 396: Student's t-quantiles" (1970). Exact for one and two degrees of freedom, and approaches
+// inverse_normal_cdf as the degrees of freedom grow.
+double student_t_quantile(double probability, double degrees_of_freedom)
+{
+    if (probability <= 0.0)
+    {
+        return -std::numeric_limits<double>::infinity();
+    }
+    if (probability >= 1.0)
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+    if (probability == 0.5)
+    {
+        return 0.0;
+    }
+    double sign = (probability > 0.5) ? 1.0 : -1.0;
+    // Two sided tail probability
+    double p = 2.0 * std::min(probability, 1.0 - probability);
+    double n = degrees_of_freedom;
+
+    double q;
+    if (n == 1.0)
+    {
+        q = 1.0 / std::tan(0.5 * M_PI * p);
+    }
+    else if (n == 2.0)
+    {
+        q = std::sqrt(2.0 / (p * (2.0 - p)) - 2.0);
+    }
+    else
     {
-        x += precision;
-        quantile = normalCDF(x);
+        double a = 1.0 / (n - 0.5);
+        double b = 48.0 / (a * a);
+        double c = ((20700.0 * a / b - 98.0) * a - 16.0) * a + 96.36;
+        double d = ((94.5 / (b + c) - 3.0) / b + 1.0) * std::sqrt(a * M_PI_2) * n;
+        double y = std::pow(d * p, 2.0 / n);
+        if ((n < 2.1 && p > 0.5) || y > 0.05 + a)
+        {
+            // Asymptotic expansion around the normal quantile
+            double x = inverse_normal_cdf(0.5 * p);
+            y = x * x;
+            if (n < 5.0)
+            {
+                c += 0.3 * (n - 4.5) * (x + 0.6);
+            }
+            c = (((0.05 * d * x - 5.0) * x - 7.0) * x - 2.0) * x + b + c;
+            y = (((((0.4 * y + 6.3) * y + 36.0) * y + 94.5) / c - y - 3.0) / b + 1.0) * x;
+            y = std::expm1(a * y * y);
+        }
+        else
+        {
+            y = ((1.0 / (((n + 6.0) / (n * y) - 0.089 * d - 0.822) * (n + 2.0) * 3.0) + 0.5 / (n + 4.0)) * y - 1.0) *
+                    (n + 1.0) / (n + 2.0) +
+                1.0 / y;
+        }
+        q = std::sqrt(n * y);
     }
-    return x;
+    return sign * q;
 }
 
 } // namespace Statistics
\ No newline at end of file
@@ -1,10 +1,5 @@
 #include "damage_sources.hpp"
 
-Damage_sources::Damage_sources()
-{
-    damage_instances.reserve(500);
-};
-
 Damage_sources& Damage_sources::operator+(const Damage_sources& rhs)
 {
     whirlwind_damage = whirlwind_damage + rhs.whirlwind_damage;
@@ -35,7 +30,7 @@ Damage_sources& Damage_sources::operator+(const Damage_sources& rhs)
 
 void Damage_sources::add_damage(Damage_source source, double damage, double time_stamp, bool increment_counter)
 {
-    if (increment_counter)
+    if (increment_counter && record_damage_instances)
     {
         damage_instances.emplace_back(source, damage, time_stamp);
     }
@@ -89,4 +84,13 @@ void Damage_sources::add_damage(Damage_source source, double damage, double time
         }
         break;
     }
-}
\ No newline at end of file
+}
+
+void Damage_sources::reset(bool record_instances)
+{
+    std::vector<Damage_instance> instances = std::move(damage_instances);
+    instances.clear();
+    *this = Damage_sources{};
+    damage_instances = std::move(instances);
+    record_damage_instances = record_instances;
+}
@@ -6,6 +6,8 @@
 #include <Character.hpp>
 #include <Combat_simulator.hpp>
 #include <Item_optimizer.hpp>
+#include <algorithm>
+#include <chrono>
 #include <sstream>
 
 namespace
@@ -27,6 +29,16 @@ void mod_hit_effects(std::vector<Hit_effect>& hit_effects, double factor)
         }
     }
 }
+
+// Paired stat weights are simulated in rounds of this many fights. They stop when the 95% confidence interval of the
+// weight is within the relative or the absolute (DPS) precision, or when n_simulations_stat_weights is reached.
+constexpr size_t paired_round_size = 1000;
+constexpr size_t paired_min_fights = 2000;
+constexpr double paired_relative_precision = 0.02;
+constexpr double paired_absolute_precision = 0.05;
+
+// Width of the DPS histogram bins
+constexpr double histogram_bin_width = 10.0;
 } // namespace
 
 void item_upgrades(std::string& item_strengths_string, Character character_new, Item_optimizer& item_optimizer,
@@ -79,7 +91,6 @@ void item_upgrades(std::string& item_strengths_string, Character character_new,
         }
     }
 
-    double quantile = Statistics::find_cdf_quantile(0.95, 0.01);
     std::string best_armor_name{};
     bool found_upgrade = false;
     for (size_t i = 0; i < items.size(); i++)
@@ -92,6 +103,7 @@ void item_upgrades(std::string& item_strengths_string, Character character_new,
                                simulator.get_dps_variance(), cumulative_simulations[iter]);
             double sample_std =
                 Statistics::sample_deviation(std::sqrt(simulator.get_dps_variance()), cumulative_simulations[iter + 1]);
+            double quantile = Statistics::student_t_quantile(0.95, cumulative_simulations[iter + 1] - 1.0);
             if (simulator.get_dps_mean() - sample_std * quantile >= dps_mean && cumulative_simulations[iter + 1] > 5000)
             {
                 found_upgrade = true;
@@ -150,7 +162,6 @@ void item_upgrades_wep(std::string& item_strengths_string, Character character_n
         }
     }
 
-    double quantile = Statistics::find_cdf_quantile(0.95, 0.01);
     std::string best_armor_name{};
     bool found_upgrade = false;
     for (auto& item : items)
@@ -163,6 +174,7 @@ void item_upgrades_wep(std::string& item_strengths_string, Character character_n
                                simulator.get_dps_variance(), cumulative_simulations[iter]);
             double sample_std =
                 Statistics::sample_deviation(std::sqrt(simulator.get_dps_variance()), cumulative_simulations[iter + 1]);
+            double quantile = Statistics::student_t_quantile(0.95, cumulative_simulations[iter + 1] - 1.0);
             if (simulator.get_dps_mean() - sample_std * quantile >= dps_mean && cumulative_simulations[iter + 1] > 5000)
             {
                 found_upgrade = true;
@@ -209,9 +221,9 @@ struct Stat_weight
     std::string stat;
 };
 
-Stat_weight compute_stat_weight(Combat_simulator& combat_simulator, Character& char_plus, Character& char_minus,
-                                const std::string& permuted_stat, double permute_amount, double permute_factor,
-                                double mean_init, double sample_std_init)
+Stat_weight compute_stat_weight(Combat_simulator& combat_simulator, const Character& char_plus,
+                                const Character& char_minus, const std::string& permuted_stat, double permute_amount,
+                                double permute_factor, double mean_init, double sample_std_init)
 {
     combat_simulator.simulate(char_plus);
     double mean_plus = combat_simulator.get_dps_mean();
@@ -231,6 +243,62 @@ Stat_weight compute_stat_weight(Combat_simulator& combat_simulator, Character& c
             permuted_stat};
 }
 
+// Simulates the perturbed characters on the same fights, i.e., the same random streams, as the baseline character
+// (common random numbers). Most of the fight to fight noise then cancels in the per fight DPS differences, which
+// gives a much smaller standard error than two independent runs. The baseline fights are kept in baseline_dps and
+// reused by the next stat weight.
+Stat_weight compute_stat_weight_paired(Combat_simulator& combat_simulator, const Character& character,
+                                       std::vector<double>& baseline_dps, const Character& char_plus,
+                                       const Character& char_minus, const std::string& permuted_stat,
+                                       double permute_amount, double permute_factor, size_t max_fights)
+{
+    const double quantile = Statistics::inverse_normal_cdf(0.975);
+    auto is_precise = [quantile, permute_factor](const Statistics::Running_statistics& difference) {
+        double half_width = quantile * difference.get_standard_error() / permute_factor;
+        double weight = std::abs(difference.get_mean() / permute_factor);
+        return half_width <= std::max(paired_relative_precision * weight, paired_absolute_precision);
+    };
+
+    combat_simulator.set_record_fight_dps(true);
+    Statistics::Running_statistics plus;
+    Statistics::Running_statistics minus;
+    size_t n_fights = 0;
+    while (n_fights < max_fights)
+    {
+        // Rounds are always aligned the same way, since the fight time ramp depends on the round size
+        size_t round_size = std::min(paired_round_size, max_fights - n_fights);
+        if (baseline_dps.size() < n_fights + round_size)
+        {
+            combat_simulator.set_fight_index(n_fights);
+            combat_simulator.simulate(character, round_size);
+            const auto& fight_dps = combat_simulator.get_fight_dps();
+            baseline_dps.insert(baseline_dps.end(), fight_dps.begin(), fight_dps.end());
+        }
+        combat_simulator.set_fight_index(n_fights);
+        combat_simulator.simulate(char_plus, round_size);
+        for (size_t i = 0; i < round_size; i++)
+        {
+            plus.push(combat_simulator.get_fight_dps()[i] - baseline_dps[n_fights + i]);
+        }
+        combat_simulator.set_fight_index(n_fights);
+        combat_simulator.simulate(char_minus, round_size);
+        for (size_t i = 0; i < round_size; i++)
+        {
+            minus.push(combat_simulator.get_fight_dps()[i] - baseline_dps[n_fights + i]);
+        }
+        n_fights += round_size;
+        if (n_fights >= paired_min_fights && is_precise(plus) && is_precise(minus))
+        {
+            break;
+        }
+    }
+    combat_simulator.set_record_fight_dps(false);
+
+    return {plus.get_mean() / permute_factor,  plus.get_standard_error() / permute_factor,
+            minus.get_mean() / permute_factor, minus.get_standard_error() / permute_factor,
+            permute_amount,              permuted_stat};
+}
+
 std::vector<double> get_damage_sources(const Damage_sources& damage_sources_vector)
 {
     return {damage_sources_vector.white_mh_damage / damage_sources_vector.sum_damage_sources(),
@@ -407,22 +475,57 @@ Sim_output Sim_interface::simulate(const Sim_input& input)
     Combat_simulator simulator{};
     simulator.set_config(config);
 
+    // Both setups of a comparison are simulated on the same fights, which allows a paired estimate of the difference
+    const bool compare_setups = input.compare_armor.size() == 15 && input.compare_weapons.size() == 2;
+    simulator.set_record_fight_dps(compare_setups);
+
+    // The progress is reported about every percent of the fights, a cancel request is noticed every
+    // Combat_simulator::progress_interval fights
+    const auto start_time = std::chrono::steady_clock::now();
+    const size_t n_simulations = std::max(config.n_batches, 1);
+    const size_t progress_chunk = std::max(n_simulations / 100, size_t{1});
+    size_t next_report = progress_chunk;
+    simulator.set_progress_callback([&](const Statistics::Running_statistics& dps_statistics) {
+        if (cancelled_)
+        {
+            return false;
+        }
+        if (dps_statistics.get_count() < next_report)
+        {
+            return true;
+        }
+        next_report = dps_statistics.get_count() + progress_chunk;
+        Sim_progress progress;
+        progress.n_simulations = dps_statistics.get_count();
+        progress.dps_mean = dps_statistics.get_mean();
+        progress.dps_error_margin = dps_statistics.get_standard_error();
+        progress.n_keepers = 1;
+        progress.elapsed_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        progress.fraction_done = std::min(static_cast<double>(progress.n_simulations) / n_simulations, 1.0);
+        progress.remaining_time = progress.elapsed_time * (1 - progress.fraction_done) / progress.fraction_done;
+        return report_progress(progress);
+    });
     simulator.simulate(character, 0, true, true);
+    simulator.set_progress_callback([this](const Statistics::Running_statistics&) { return !cancelled_; });
+    simulator.set_record_fight_dps(false);
+    const std::vector<double> fight_dps = simulator.get_fight_dps();
     const double dps_mean = simulator.get_dps_mean();
     const double dps_sample_std =
-        Statistics::sample_deviation(std::sqrt(simulator.get_dps_variance()), input.n_simulations);
+        Statistics::sample_deviation(std::sqrt(simulator.get_dps_variance()), simulator.get_n_simulations());
 
     std::vector<double> mean_dps_vec;
     std::vector<double> sample_std_dps_vec;
 
-    auto hist_x = simulator.get_hist_x();
-    auto hist_y = simulator.get_hist_y();
+    std::vector<double> hist_x;
+    std::vector<int> hist_y;
+    const auto& dps_sketch = simulator.get_dps_sketch();
+    dps_sketch.get_histogram(histogram_bin_width, hist_x, hist_y);
 
     const auto dmg_dist = simulator.get_damage_distribution();
     std::vector<double> dps_dist_raw = get_damage_sources(dmg_dist);
     double mean_init = simulator.get_dps_mean();
     double std_init = std::sqrt(simulator.get_dps_variance());
-    double sample_std_init = Statistics::sample_deviation(std_init, config.n_batches);
+    double sample_std_init = Statistics::sample_deviation(std_init, simulator.get_n_simulations());
 
     std::vector<std::string> aura_uptimes = simulator.get_aura_uptimes();
     std::vector<std::string> proc_statistics = simulator.get_proc_statistics();
@@ -470,7 +573,13 @@ Sim_output Sim_interface::simulate(const Sim_input& input)
                  string_with_precision(simulator.get_rage_lost_exec() / double(simulator.get_n_simulations()), 3) +
                  "</b><br>";
 
-    std::string extra_info_string = "<b>Fight stats vs. target:</b> <br/>";
+    std::string extra_info_string = "<b>DPS distribution:</b> <br/>";
+    for (double percentile : {5, 50, 95, 99})
+    {
+        extra_info_string += std::to_string(static_cast<int>(percentile)) + "th percentile: <b>" +
+                             string_with_precision(dps_sketch.get_quantile(percentile / 100), 5) + "</b> DPS<br>";
+    }
+    extra_info_string += "<br><b>Fight stats vs. target:</b> <br/>";
     extra_info_string += "<b>Hit:</b> <br/>";
     double yellow_miss_chance = yellow_ht[0];
     double white_mh_miss_chance = white_mh_ht[0];
@@ -511,7 +620,7 @@ Sim_output Sim_interface::simulate(const Sim_input& input)
     std::string dpr_info = "<br>(Hint: Ability damage per rage computations can be turned on under 'Simulation "
                            "settings')";
     config.performance_mode = true;
-    if (find_string(input.options, "compute_dpr"))
+    if (!cancelled_ && find_string(input.options, "compute_dpr"))
     {
         config.n_batches = 5000;
         dpr_info = "<br><b>Ability damage per rage:</b><br>";
@@ -667,7 +776,7 @@ Sim_output Sim_interface::simulate(const Sim_input& input)
     }
 
     std::string talents_info = "<br>(Hint: Talent stat-weights can be activated under 'Simulation settings')";
-    if (find_string(input.options, "talents_stat_weights"))
+    if (!cancelled_ && find_string(input.options, "talents_stat_weights"))
     {
         double delta_dps{};
         config.n_batches = 5000;
@@ -747,18 +856,33 @@ Sim_output Sim_interface::simulate(const Sim_input& input)
         config.talents.dual_wield_specialization += 2;
     }
 
-    if (input.compare_armor.size() == 15 && input.compare_weapons.size() == 2)
+    if (!cancelled_ && compare_setups)
     {
+        // The second setup runs the same fights as the first, also when its simulation was stopped early
+        Combat_simulator_config compare_config = config;
+        compare_config.n_batches = static_cast<int>(fight_dps.size());
         Combat_simulator simulator_compare{};
-        simulator_compare.set_config(config);
+        simulator_compare.set_config(compare_config);
         Character character2 = character_setup(armory, input.race[0], input.compare_armor, input.compare_weapons,
                                                temp_buffs, input.enchants);
 
+        simulator_compare.set_record_fight_dps(true);
         simulator_compare.simulate(character2);
 
+        Statistics::Running_statistics difference;
+        for (size_t i = 0; i < fight_dps.size(); i++)
+        {
+            difference.push(simulator_compare.get_fight_dps()[i] - fight_dps[i]);
+        }
+        double quantile = Statistics::student_t_quantile(0.975, fight_dps.size() - 1.0);
+        extra_info_string += "<br><b>Setup 2 vs. setup 1:</b> <br/>DPS difference: <b>" +
+                             string_with_precision(difference.get_mean(), 4) + " &plusmn " +
+                             string_with_precision(quantile * difference.get_standard_error(), 3) +
+                             "</b> (95% confidence interval, paired over identical fights)<br>";
+
         double mean_init_2 = simulator_compare.get_dps_mean();
         double std_init_2 = std::sqrt(simulator_compare.get_dps_variance());
-        double sample_std_init_2 = Statistics::sample_deviation(std_init_2, config.n_batches);
+        double sample_std_init_2 = Statistics::sample_deviation(std_init_2, compare_config.n_batches);
 
         character_stats = get_character_stat(character, character2);
 
@@ -767,7 +891,7 @@ Sim_output Sim_interface::simulate(const Sim_input& input)
     }
 
     std::string item_strengths_string;
-    if (find_string(input.options, "item_strengths"))
+    if (!cancelled_ && find_string(input.options, "item_strengths"))
     {
         item_strengths_string = "<b>Character items and proposed upgrades:</b><br>";
         //                std::vector<size_t> batches_per_iteration = {100, 200, 500, 1000};
@@ -834,15 +958,25 @@ Sim_output Sim_interface::simulate(const Sim_input& input)
     config.n_batches = input.n_simulations_stat_weights;
     simulator.set_config(config);
     std::vector<std::string> stat_weights;
-    if (!input.stat_weights.empty())
+    const bool paired_stat_weights = find_string(input.options, "paired_stat_weights");
+    std::vector<double> baseline_dps;
+    auto compute_weight = [&](const Character& char_plus, const Character& char_minus, const std::string& stat,
+                              double amount, double factor) {
+        if (paired_stat_weights)
+        {
+            return compute_stat_weight_paired(simulator, character, baseline_dps, char_plus, char_minus, stat, amount,
+                                              factor, config.n_batches);
+        }
+        return compute_stat_weight(simulator, char_plus, char_minus, stat, amount, factor, mean_init, sample_std_init);
+    };
+    if (!cancelled_ && !input.stat_weights.empty())
     {
         {
             Character char_plus = character;
             Character char_minus = character;
             char_plus.total_special_stats.attack_power += 300;
             char_minus.total_special_stats.attack_power -= 300;
-            Stat_weight base_line = compute_stat_weight(simulator, char_plus, char_minus, "attack power", 100, 3,
-                                                        mean_init, sample_std_init);
+            Stat_weight base_line = compute_weight(char_plus, char_minus, "attack power", 100, 3);
             stat_weights.emplace_back(
                 "attack_power: " + std::to_string(base_line.dps_plus) + " " + std::to_string(base_line.std_dps_plus) +
                 " " + std::to_string(base_line.dps_minus) + " " + std::to_string(base_line.std_dps_minus));
@@ -850,14 +984,17 @@ Sim_output Sim_interface::simulate(const Sim_input& input)
 
         for (const auto& stat_weight : input.stat_weights)
         {
+            if (cancelled_)
+            {
+                break;
+            }
             if (stat_weight == "crit")
             {
                 Character char_plus = character;
                 Character char_minus = character;
                 char_plus.total_special_stats.critical_strike += 2;
                 char_minus.total_special_stats.critical_strike -= 2;
-                Stat_weight crit =
-                    compute_stat_weight(simulator, char_plus, char_minus, "crit", 1, 2, mean_init, sample_std_init);
+                Stat_weight crit = compute_weight(char_plus, char_minus, "crit", 1, 2);
                 stat_weights.emplace_back("1%Crit " + std::to_string(crit.dps_plus) + " " +
                                           std::to_string(crit.std_dps_plus) + " " + std::to_string(crit.dps_minus) +
                                           " " + std::to_string(crit.std_dps_minus));
@@ -869,8 +1006,7 @@ Sim_output Sim_interface::simulate(const Sim_input& input)
                 Character char_minus = character;
                 char_plus.total_special_stats.hit += 1;
                 char_minus.total_special_stats.hit -= 1;
-                Stat_weight hit =
-                    compute_stat_weight(simulator, char_plus, char_minus, "hit", 1, 1, mean_init, sample_std_init);
+                Stat_weight hit = compute_weight(char_plus, char_minus, "hit", 1, 1);
                 stat_weights.emplace_back("1%Hit " + std::to_string(hit.dps_plus) + " " +
                                           std::to_string(hit.std_dps_plus) + " " + std::to_string(hit.dps_minus) + " " +
                                           std::to_string(hit.std_dps_minus));
@@ -881,8 +1017,7 @@ Sim_output Sim_interface::simulate(const Sim_input& input)
                 Character char_minus = character;
                 char_plus.total_special_stats.haste = (char_plus.total_special_stats.haste + 1) * 1.1 - 1;
                 char_minus.total_special_stats.haste = (char_minus.total_special_stats.haste + 1) / 1.1 - 1;
-                Stat_weight hit =
-                    compute_stat_weight(simulator, char_plus, char_minus, "haste", 1, 10, mean_init, sample_std_init);
+                Stat_weight hit = compute_weight(char_plus, char_minus, "haste", 1, 10);
                 stat_weights.emplace_back("1%Haste " + std::to_string(hit.dps_plus) + " " +
                                           std::to_string(hit.std_dps_plus) + " " + std::to_string(hit.dps_minus) + " " +
                                           std::to_string(hit.std_dps_minus));
@@ -894,8 +1029,7 @@ Sim_output Sim_interface::simulate(const Sim_input& input)
                 Hit_effect extra_hit{"stat_weight_extra_hit", Hit_effect::Type::extra_hit, {}, {}, 0, 0, 0.05};
                 char_plus.weapons[0].hit_effects.emplace_back(extra_hit);
                 char_plus.weapons[1].hit_effects.emplace_back(extra_hit);
-                Stat_weight hit = compute_stat_weight(simulator, char_plus, char_minus, "extra_hit", 1, 5, mean_init,
-                                                      sample_std_init);
+                Stat_weight hit = compute_weight(char_plus, char_minus, "extra_hit", 1, 5);
                 stat_weights.emplace_back("1%ExtraHit " + std::to_string(hit.dps_plus) + " " +
                                           std::to_string(hit.std_dps_plus) + " " + std::to_string(hit.dps_minus) + " " +
                                           std::to_string(hit.std_dps_minus));
@@ -915,8 +1049,7 @@ Sim_output Sim_interface::simulate(const Sim_input& input)
                 char_minus.weapons[0].max_damage *= factor_n;
                 char_minus.weapons[0].swing_speed -= swing_speed_diff;
                 mod_hit_effects(char_minus.weapons[0].hit_effects, factor_n);
-                Stat_weight hit = compute_stat_weight(simulator, char_plus, char_minus, "mh_speed", 0.5, 1, mean_init,
-                                                      sample_std_init);
+                Stat_weight hit = compute_weight(char_plus, char_minus, "mh_speed", 0.5, 1);
                 stat_weights.emplace_back("0.5-MH-speed " + std::to_string(hit.dps_plus) + " " +
                                           std::to_string(hit.std_dps_plus) + " " + std::to_string(hit.dps_minus) + " " +
                                           std::to_string(hit.std_dps_minus));
@@ -936,8 +1069,7 @@ Sim_output Sim_interface::simulate(const Sim_input& input)
                 char_minus.weapons[1].max_damage *= factor_n;
                 char_minus.weapons[1].swing_speed -= swing_speed_diff;
                 mod_hit_effects(char_minus.weapons[1].hit_effects, factor_n);
-                Stat_weight hit = compute_stat_weight(simulator, char_plus, char_minus, "oh_speed", 0.5, 1, mean_init,
-                                                      sample_std_init);
+                Stat_weight hit = compute_weight(char_plus, char_minus, "oh_speed", 0.5, 1);
                 stat_weights.emplace_back("0.5-OH-speed " + std::to_string(hit.dps_plus) + " " +
                                           std::to_string(hit.std_dps_plus) + " " + std::to_string(hit.dps_minus) + " " +
                                           std::to_string(hit.std_dps_minus));
@@ -976,8 +1108,7 @@ Sim_output Sim_interface::simulate(const Sim_input& input)
                     break;
                 }
 
-                Stat_weight hit =
-                    compute_stat_weight(simulator, char_plus, char_minus, "skill", 5, 1, mean_init, sample_std_init);
+                Stat_weight hit = compute_weight(char_plus, char_minus, "skill", 5, 1);
                 char_plus.total_special_stats = character.total_special_stats;
                 char_minus.total_special_stats = character.total_special_stats;
 
@@ -1040,6 +1171,8 @@ Sim_output Sim_interface::simulate(const Sim_input& input)
         debug_topic += "#Hits item effects: " + std::to_string(dist.item_hit_effects_count) + "<br>";
     }
 
+    // The cancel request has been served, a cancel from before this call started stopped this call as well
+    cancelled_ = false;
     return {hist_x,
             hist_y,
             dps_dist,
@@ -1,4 +1,5 @@
 #include "Armory.hpp"
+#include "Best_arm_identification.hpp"
 #include "Character.hpp"
 #include "Combat_simulator.hpp"
 #include "Helper_functions.cpp"
@@ -7,12 +8,18 @@
 #include "sim_interface.hpp"
 
 #include <algorithm>
-#include <ctime>
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <thread>
 
 Sim_output_mult Sim_interface::simulate_mult(const Sim_input_mult& input)
 {
-    clock_t start_time_main = clock();
+    // Time limits are wall clock time, CPU time would grow with the number of threads
+    auto seconds_since = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    const auto start_time_main = std::chrono::steady_clock::now();
     Buffs buffs{};
     Item_optimizer item_optimizer;
 
@@ -34,8 +41,6 @@ Sim_output_mult Sim_interface::simulate_mult(const Sim_input_mult& input)
 
     // Simulator & Combat settings
     Combat_simulator_config config{input};
-    Combat_simulator simulator{};
-    simulator.set_config(config);
 
     std::string debug_message;
     item_optimizer.compute_combinations();
@@ -44,7 +49,7 @@ Sim_output_mult Sim_interface::simulate_mult(const Sim_input_mult& input)
     std::cout << "init. Combinations: " << std::to_string(item_optimizer.total_combinations) << "\n";
     debug_message += "Total item combinations: " + std::to_string(item_optimizer.total_combinations) + "<br>";
     debug_message += "Filtering weaker items.<br>";
-    clock_t start_filter = clock();
+    const auto start_filter = std::chrono::steady_clock::now();
     {
         auto character = item_optimizer.construct(0);
         item_optimizer.filter_weaker_items(character.total_special_stats, debug_message);
@@ -58,83 +63,24 @@ Sim_output_mult Sim_interface::simulate_mult(const Sim_input_mult& input)
     {
         debug_message += "Performing a heuristic filter on the item sets.<br>";
         std::cout << "Performing a heuristic filter on the item sets.\n";
-        double highest_attack_power = 0;
-        double lowest_attack_power = 1e12;
-        for (size_t i = 0; i < item_optimizer.total_combinations; ++i)
+        // Keeps the best 60% of the sets by AP equivalent, but at most 10.000 sets
+        size_t n_keepers = std::min(item_optimizer.total_combinations - item_optimizer.total_combinations * 2 / 5,
+                                    size_t{10000});
+        keepers = item_optimizer.find_best_ap_equivalents(n_keepers, debug_message);
+        double lowest_attack_power = keepers.front().ap_equivalent;
+        double highest_attack_power = keepers.front().ap_equivalent;
+        for (const auto& keeper : keepers)
         {
-            Character character = item_optimizer.construct(i);
-            double ap_equivalent = item_optimizer.get_total_qp_equivalent(
-                character.total_special_stats, character.weapons[0], character.weapons[1], character.use_effects);
-            if (ap_equivalent > highest_attack_power)
-            {
-                highest_attack_power = ap_equivalent;
-            }
-            if (ap_equivalent < lowest_attack_power)
-            {
-                lowest_attack_power = ap_equivalent;
-            }
+            lowest_attack_power = std::min(lowest_attack_power, keeper.ap_equivalent);
+            highest_attack_power = std::max(highest_attack_power, keeper.ap_equivalent);
         }
-
-        debug_message += "Equivalent attack power range: [" + std::to_string(lowest_attack_power) + ", " +
+        debug_message += "Kept equivalent attack power range: [" + std::to_string(lowest_attack_power) + ", " +
                          std::to_string(highest_attack_power) + "]<br>";
-        std::cout << "Equivalent attack power range: [" + std::to_string(lowest_attack_power) + ", " +
+        std::cout << "Kept equivalent attack power range: [" + std::to_string(lowest_attack_power) + ", " +
                          std::to_string(highest_attack_power) + "]\n";
-        double filter_value = .4;
-        double filtering_ap = (1 - filter_value) * lowest_attack_power + filter_value * highest_attack_power;
-        debug_message += "Removing bottom " + string_with_precision(filter_value * 100, 2) + "% sets. AP < " +
-                         string_with_precision(filtering_ap, 4) + "<br>";
-        std::cout << "Removing bottom " + string_with_precision(filter_value * 100, 2) + "% sets. AP < " +
-                         string_with_precision(filtering_ap, 4) + "\n";
-        keepers.reserve(item_optimizer.total_combinations / 2);
-        for (size_t i = 0; i < item_optimizer.total_combinations; ++i)
-        {
-            Character character = item_optimizer.construct(i);
-            double ap_equivalent = item_optimizer.get_total_qp_equivalent(
-                character.total_special_stats, character.weapons[0], character.weapons[1], character.use_effects);
-            if (ap_equivalent > filtering_ap)
-            {
-                keepers.emplace_back(i, 0, 0, ap_equivalent);
-            }
-        }
+        double time_spent_filter = seconds_since(start_filter);
         debug_message += "Set filter done. Combinations: " + std::to_string(keepers.size()) + "<br>";
         std::cout << "Set filter done. Combinations: " << std::to_string(keepers.size()) << "\n";
-        if (keepers.size() > 10000)
-        {
-            debug_message += "To many combinations. Combinations: " + std::to_string(keepers.size()) + "<br>";
-            debug_message += "Increasing filter value until <10.000 sets remaining.<br>";
-            std::cout << "To many combinations. Combinations: " << std::to_string(keepers.size()) << "\n";
-            std::cout << "Increasing filter value until 10.000 sets remaining.<br>\n";
-            while (keepers.size() > 10000)
-            {
-                filter_value += .02;
-                filtering_ap = (1 - filter_value) * lowest_attack_power + filter_value * highest_attack_power;
-                debug_message += "Removing bottom " + string_with_precision(filter_value * 100, 2) + "% sets. AP < " +
-                                 string_with_precision(filtering_ap, 4) + "<br>";
-                std::cout << "Removing bottom " << string_with_precision(filter_value * 100, 2) << "%\n";
-                std::vector<Item_optimizer::Sim_result_t> temp_keepers;
-                temp_keepers.reserve(keepers.size());
-                for (const auto& keeper : keepers)
-                {
-                    if (keeper.ap_equivalent > filtering_ap)
-                    {
-                        temp_keepers.emplace_back(keeper);
-                    }
-                }
-                keepers = temp_keepers;
-                debug_message += "Sets remaining: " + std::to_string(keepers.size()) + "<br>";
-                std::cout << "Sets remaining: " << std::to_string(keepers.size()) << "\n";
-            }
-        }
-        double time_spent_filter = double(clock() - start_filter) / (double)CLOCKS_PER_SEC;
-        debug_message += "Set filter done. Combinations: " + std::to_string(keepers.size()) + "<br>";
-        if (filter_value > 0.8)
-        {
-            debug_message +=
-                "WARNING! Pushed the heuristic filter to: " + string_with_precision(filter_value * 100, 2) +
-                "%. Might have filtered away good sets. <br>";
-            std::cout << "WARNING! Pushed the heuristic filter to: " << string_with_precision(filter_value * 100, 2)
-                      << "\n";
-        }
         debug_message += "Time spent filtering: " + std::to_string(time_spent_filter) + "s.<br><br>";
     }
     else
@@ -142,72 +88,134 @@ Sim_output_mult Sim_interface::simulate_mult(const Sim_input_mult& input)
         keepers.reserve(item_optimizer.total_combinations);
         for (size_t i = 0; i < item_optimizer.total_combinations; ++i)
         {
-            Character character = item_optimizer.construct(i);
             keepers.emplace_back(i, 0, 0, 0);
         }
     }
 
+    // Every gear set is constructed once here, the rounds below only read the cached characters
+    item_optimizer.cache_characters(keepers);
     debug_message += "Starting optimizer! Current combinations:" + std::to_string(keepers.size()) + "<br>";
-    std::vector<size_t> batches_per_iteration = {20};
-    std::vector<size_t> cumulative_simulations = {0};
-    for (int i = 0; i < 40; i++)
-    {
-        batches_per_iteration.push_back(batches_per_iteration.back() * 1.2);
-        cumulative_simulations.push_back(cumulative_simulations.back() + batches_per_iteration[i]);
-    }
-    cumulative_simulations.push_back(cumulative_simulations.back() + batches_per_iteration.back());
-    size_t n_sim{};
-    size_t performed_iterations{};
-    for (size_t i = 0; i < batches_per_iteration.size(); i++)
-    {
-        clock_t optimizer_start_time = clock();
-        debug_message +=
-            "Iteration " + std::to_string(i + 1) + " of " + std::to_string(batches_per_iteration.size()) + "<br>";
-        debug_message += "Total keepers: " + std::to_string(keepers.size()) + "<br>";
+    // Best arm identification on the fight by fight DPS difference to the leading set, see Best_arm_identification.
+    // The fights are simulated in blocks of growing size. Every set runs the same blocks, so fight j of one set has
+    // the same random streams and fight time as fight j of any other set.
+    constexpr double confidence = 0.99;
+    constexpr size_t min_reported_sets = 5;
+    Best_arm_identification best_arm{keepers.size(), confidence, min_reported_sets, 20, 1.2, 41};
 
-        std::cout << "Iter: " + std::to_string(i) + ". Total keepers: " + std::to_string(keepers.size()) << "\n";
+    // The keepers still in the running with the statistics of their fights, the leader first
+    auto get_remaining_keepers = [&keepers, &best_arm]() {
+        std::vector<Item_optimizer::Sim_result_t> remaining_keepers;
+        remaining_keepers.reserve(best_arm.get_arms().size());
+        for (auto arm : best_arm.get_arms())
+        {
+            const auto& statistics = best_arm.get_statistics(arm);
+            remaining_keepers.emplace_back(keepers[arm]);
+            remaining_keepers.back().mean_dps = statistics.get_mean();
+            remaining_keepers.back().variance = statistics.get_variance();
+            remaining_keepers.back().n_simulations = statistics.get_count();
+        }
+        return remaining_keepers;
+    };
 
-        double best_dps = 0;
-        double best_dps_variance = 0;
-        size_t iter = 0;
-        for (auto& keeper : keepers)
+    // Every worker owns a simulator and evaluates the sampled keepers until the round is done. The fights of a keeper
+    // only depend on the blocks it runs, so the results do not depend on the thread count or on which worker
+    // evaluated which keeper.
+    const int n_workers = Combat_simulator::threads_supported() ? std::max(config.n_threads, 1) : 1;
+    config.n_threads = 1;
+    std::vector<Combat_simulator> simulators(n_workers);
+    for (auto& worker_simulator : simulators)
+    {
+        worker_simulator.set_config(config);
+        worker_simulator.set_record_fight_dps(true);
+    }
+    // A cancel request is noticed after every keeper, the keepers left in the round keep their earlier fights
+    auto evaluate_keepers = [this, &keepers, &item_optimizer, &best_arm](Combat_simulator& worker_simulator,
+                                                                        std::atomic<size_t>& next_keeper) {
+        const auto& sampled_arms = best_arm.get_sampled_arms();
+        for (size_t k = next_keeper++; k < sampled_arms.size() && !cancelled_; k = next_keeper++)
         {
-            Character character = item_optimizer.construct(keeper.index);
-            simulator.simulate(character, batches_per_iteration[i], keeper.mean_dps, keeper.variance,
-                               cumulative_simulations[i]);
-            keeper.mean_dps = simulator.get_dps_mean();
-            keeper.variance = simulator.get_dps_variance();
-            if (keeper.mean_dps > best_dps)
+            size_t arm = sampled_arms[k];
+            const Character& character = item_optimizer.get_cached_character(keepers[arm].index);
+            for (size_t block = best_arm.get_block(best_arm.get_n_samples(arm)); block < best_arm.get_target_block();
+                 block++)
             {
-                best_dps = keeper.mean_dps;
-                best_dps_variance = keeper.variance;
+                worker_simulator.set_fight_index(best_arm.get_block_start(block));
+                worker_simulator.simulate(character, best_arm.get_block_size(block));
+                best_arm.add_samples(arm, worker_simulator.get_fight_dps());
             }
+        }
+    };
+
+    for (size_t i = 0;; i++)
+    {
+        auto optimizer_start_time = std::chrono::steady_clock::now();
+        debug_message += "Round " + std::to_string(i + 1) + ", simulating " +
+                         std::to_string(best_arm.get_sampled_arms().size()) + " sets up to " +
+                         std::to_string(best_arm.get_target_samples()) + " fights<br>";
+        debug_message += "Total keepers: " + std::to_string(best_arm.get_arms().size()) + "<br>";
+
+        std::cout << "Iter: " + std::to_string(i) + ". Total keepers: " + std::to_string(best_arm.get_arms().size()) +
+                         ". Simulated: " + std::to_string(best_arm.get_sampled_arms().size()) + "\n";
 
-            // Time taken
-            n_sim += batches_per_iteration[i];
-            iter++;
-            if (keepers.size() < 200)
+        std::atomic<size_t> next_keeper{0};
+        if (n_workers == 1)
+        {
+            evaluate_keepers(simulators[0], next_keeper);
+        }
+        else
+        {
+            std::vector<std::thread> threads;
+            threads.reserve(n_workers);
+            for (auto& worker_simulator : simulators)
             {
-                if (iter == 2)
-                {
-                    double time_spent = double(clock() - optimizer_start_time) / (double)CLOCKS_PER_SEC;
-                    double n_samples = keepers.size() / double(iter);
-                    debug_message += "Batch done in: " + std::to_string(time_spent * n_samples) + " seconds.";
-                }
+                threads.emplace_back(evaluate_keepers, std::ref(worker_simulator), std::ref(next_keeper));
             }
-            else
+            for (auto& thread : threads)
             {
-                if (iter == 20)
-                {
-                    double time_spent = double(clock() - optimizer_start_time) / (double)CLOCKS_PER_SEC;
-                    double n_samples = keepers.size() / double(iter);
-                    debug_message += "Batch done in: " + std::to_string(time_spent * n_samples) + " seconds.<br>";
-                }
+                thread.join();
             }
         }
+        debug_message += "Batch done in: " + std::to_string(seconds_since(optimizer_start_time)) + " seconds.<br>";
+        if (cancelled_)
+        {
+            debug_message += "<b>Cancelled! </b><br>";
+            break;
+        }
+
+        size_t n_arms = best_arm.get_arms().size();
+        auto state = best_arm.finish_round();
+        const auto& leader_statistics = best_arm.get_statistics(best_arm.get_arms().front());
+        debug_message += "Best combination DPS: " + std::to_string(leader_statistics.get_mean()) +
+                         ", removing sets below with an error of " +
+                         percent_to_str(100 * (1 - best_arm.get_round_confidence())) + " each<br>";
+        if (best_arm.get_arms().size() < n_arms)
+        {
+            item_optimizer.retain_cached_characters(get_remaining_keepers());
+        }
+
+        if (state == Best_arm_identification::State::separated)
+        {
+            debug_message += "<b>Best combination separated with " + percent_to_str(100 * confidence) +
+                             " confidence. breaking! </b><br>";
+            break;
+        }
 
         // Check if max time is exceeded
-        double time = double(clock() - start_time_main) / (double)CLOCKS_PER_SEC;
+        double time = seconds_since(start_time_main);
+        Sim_progress progress;
+        progress.n_simulations = best_arm.get_total_samples();
+        progress.dps_mean = leader_statistics.get_mean();
+        progress.dps_error_margin = leader_statistics.get_standard_error();
+        progress.n_keepers = best_arm.get_arms().size();
+        progress.elapsed_time = time;
+        progress.remaining_time = std::max(input.max_optimize_time - time, 0.0);
+        progress.fraction_done = (input.max_optimize_time > 0) ? std::min(time / input.max_optimize_time, 1.0) : 1.0;
+        if (!report_progress(progress))
+        {
+            debug_message += "<b>Stopped with " + std::to_string(best_arm.get_arms().size()) +
+                             " combinations remaining.</b><br>";
+            break;
+        }
         if (time > input.max_optimize_time)
         {
             debug_message +=
@@ -215,62 +223,20 @@ Sim_output_mult Sim_interface::simulate_mult(const Sim_input_mult& input)
             break;
         }
 
-        // If there are more than 10 item sets: remove weak sets
-        if (keepers.size() > 5)
+        if (best_arm.get_arms().size() <= 5 && time > 20)
         {
-            double quantile = Statistics::find_cdf_quantile(1 - 1 / static_cast<double>(keepers.size()), 0.01);
-            double best_dps_sample_std =
-                Statistics::sample_deviation(std::sqrt(best_dps_variance), cumulative_simulations[i + 1]);
-            double filter_value = best_dps - quantile * best_dps_sample_std;
-            debug_message += "Best combination DPS: " + std::to_string(best_dps) +
-                             ", removing sets below: " + std::to_string(best_dps - quantile * best_dps_sample_std) +
-                             "<br>";
-            std::vector<Item_optimizer::Sim_result_t> temp_keepers;
-            temp_keepers.reserve(keepers.size());
-            for (const auto& keeper : keepers)
-            {
-                double keeper_sample_std =
-                    Statistics::sample_deviation(std::sqrt(keeper.variance), cumulative_simulations[i + 1]);
-                if (keeper.mean_dps + keeper_sample_std * quantile >= filter_value)
-                {
-                    temp_keepers.emplace_back(keeper);
-                }
-            }
-            // Removed to many sets
-            if (temp_keepers.size() < 5)
-            {
-                std::cout << "removed to many sets. Adding them back again\n";
-                size_t attempts = 0;
-                while (temp_keepers.size() < 5)
-                {
-                    quantile *= 1.01;
-                    temp_keepers.clear();
-                    for (const auto& keeper : keepers)
-                    {
-                        double keeper_sample_std =
-                            Statistics::sample_deviation(std::sqrt(keeper.variance), cumulative_simulations[i + 1]);
-                        if (keeper.mean_dps + keeper_sample_std * quantile >= filter_value)
-                        {
-                            temp_keepers.emplace_back(keeper);
-                        }
-                    }
-                    if (attempts > 200)
-                    {
-                        break;
-                    }
-                }
-            }
-            keepers = temp_keepers;
+            debug_message += +"<b>: 20 seconds passed with 5 or less combinations remaining. breaking! </b><br>";
+            break;
         }
 
-        if (keepers.size() <= 5 && time > 20)
+        if (state == Best_arm_identification::State::out_of_samples)
         {
-            debug_message += +"<b>: 20 seconds passed with 5 or less combinations remaining. breaking! </b><br>";
+            debug_message += "<b>Maximum number of simulations per set reached. breaking! </b><br>";
             break;
         }
-        performed_iterations = i;
     }
-
+    size_t n_sim = best_arm.get_total_samples();
+    keepers = get_remaining_keepers();
     std::sort(keepers.begin(), keepers.end());
     std::reverse(keepers.begin(), keepers.end());
 
@@ -414,8 +380,8 @@ Sim_output_mult Sim_interface::simulate_mult(const Sim_input_mult& input)
         message += "<b>Set " + std::to_string(i + 1) + ":</b><br>";
         message += "DPS: " + string_with_precision(keepers[i].mean_dps, 5) + " (+<b>" +
                    string_with_precision(keepers[i].mean_dps - keepers[max_number - 1].mean_dps, 3) + "</b>)<br> ";
-        double error_margin = Statistics::sample_deviation(std::sqrt(keepers[i].variance),
-                                                           cumulative_simulations[performed_iterations + 1]);
+        double error_margin =
+            Statistics::sample_deviation(std::sqrt(keepers[i].variance), keepers[i].n_simulations);
         message += "Error margin DPS: " + string_with_precision(error_margin, 3) + "<br>";
         message += "<b>Stats:</b><br>";
         message += "Hit: " + string_with_precision(best_characters[i].total_special_stats.hit, 3) + " %<br>";
@@ -448,5 +414,7 @@ Sim_output_mult Sim_interface::simulate_mult(const Sim_input_mult& input)
         message += "<br>";
     }
 
+    // The cancel request has been served, a cancel from before this call started stopped this call as well
+    cancelled_ = false;
     return {{message, debug_message}};
 }
@@ -3,7 +3,7 @@
 Weapon_sim::Weapon_sim(double swing_speed, double min_damage, double max_damage, Socket socket, Weapon_type skill_type,
                        Weapon_socket weapon_socket, std::vector<Hit_effect> hit_effects)
     : swing_speed{swing_speed}
-    , internal_swing_timer{0.0}
+    , next_swing{0.0}
     , min_damage(min_damage)
     , max_damage(max_damage)
     , average_damage{0.0}